@@ -0,0 +1,256 @@
+#include "benchmark.h"
+#include "json_reader.h"
+#include "latency_recorder.h"
+#include "map_renderer.h"
+#include "profiler.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+#include "update_check.h"
+
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <optional>
+#include <sstream>
+
+namespace bench {
+
+	using namespace std::literals;
+
+	namespace {
+
+		constexpr size_t DEFAULT_REPETITIONS   = 3;
+		constexpr size_t DEFAULT_UPDATE_ROUNDS = 8;
+
+		struct RunResult {
+			std::map<std::string, double>        phases_ms;
+			std::vector<profile::LatencySummary> queries;
+			// Answered per second of the stat_requests phase
+			double                               requests_per_second = 0.;
+		};
+
+		RunResult RunOnce(const std::string& input) {
+			renderer::MapRenderer             mr;
+			transport::TransportCatalogue     db;
+			request_handler::RequestHandler   rh(db, mr);
+			json_reader::JsonReader           reader(rh);
+			profile::Profiler        profiler = profile::Profiler::MakeEnabled();
+			profile::LatencyRecorder latency  = profile::LatencyRecorder::MakeEnabled(json_reader::GetStatRequestTypes());
+
+			std::istringstream in(input);
+			std::ostringstream out;
+			reader.Start(in, out, profiler, latency);
+
+			RunResult result;
+			for (const profile::PhaseRecord& phase : profiler.GetPhases()) {
+				result.phases_ms[phase.name] = phase.time_ms;
+				if (phase.name != "stat_requests"sv || phase.time_ms <= 0.) {
+					continue;
+				}
+				for (const auto& [name, count] : phase.counts) {
+					if (name == "requests"sv) {
+						result.requests_per_second = count / (phase.time_ms / 1000.);
+					}
+				}
+			}
+			result.queries = latency.GetSummaries();
+
+			return result;
+		}
+
+		double Median(std::vector<double> values) {
+			if (values.empty()) {
+				return 0.;
+			}
+			std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+			return values[values.size() / 2];
+		}
+
+		double ToMicroseconds(std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double, std::micro>(duration).count();
+		}
+
+		json::Dict ParamsToDict(const CityParams& params) {
+			return {
+				{ "layout"s,          json::Node(std::string(LayoutToString(params.layout)))   },
+				{ "stops"s,           json::Node(static_cast<int>(params.stop_count))          },
+				{ "buses"s,           json::Node(static_cast<int>(params.bus_count))           },
+				{ "route_length"s,    json::Node(static_cast<int>(params.route_length))        },
+				{ "roundtrip_ratio"s, json::Node(params.roundtrip_ratio)                        },
+				{ "stat_requests"s,   json::Node(static_cast<int>(params.stat_request_count))  },
+				{ "map_requests"s,    json::Node(static_cast<int>(params.map_request_count))   },
+				// A string, an int can't hold every seed
+				{ "seed"s,            json::Node(std::to_string(params.seed))                  }
+			};
+		}
+
+		json::Dict RunScenario(const Scenario& scenario, size_t repetitions) {
+			std::ostringstream document;
+			json::Print(GenerateCity(scenario.params), document);
+			const std::string input = document.str();
+
+			std::vector<RunResult> runs;
+			for (size_t i = 0; i < repetitions; ++i) {
+				runs.push_back(RunOnce(input));
+			}
+
+			json::Dict phases;
+			for (const auto& [name, time_ms] : runs.front().phases_ms) {
+				std::vector<double> times;
+				for (const RunResult& run : runs) {
+					times.push_back(run.phases_ms.at(name));
+				}
+				phases[name] = json::Node(Median(std::move(times)));
+			}
+
+			std::vector<double> requests_per_second;
+			for (const RunResult& run : runs) {
+				requests_per_second.push_back(run.requests_per_second);
+			}
+
+			// A Route between stops is charged its share of the search from its origin, the batch of them
+			// is answered on a pool of threads
+			json::Dict queries;
+			for (size_t type = 0; type < runs.front().queries.size(); ++type) {
+				const profile::LatencySummary& first = runs.front().queries[type];
+				if (first.count == 0) {
+					continue;
+				}
+				std::vector<double> mean_us, p50_us, p99_us;
+				for (const RunResult& run : runs) {
+					const profile::LatencySummary& summary = run.queries[type];
+					mean_us.push_back(ToMicroseconds(summary.sum) / summary.count);
+					p50_us.push_back(ToMicroseconds(summary.p50));
+					p99_us.push_back(ToMicroseconds(summary.p99));
+				}
+				queries[first.type] = json::Dict{
+					{ "count"s,      json::Node(static_cast<int>(first.count))      },
+					{ "mean_us"s,    json::Node(Median(std::move(mean_us)))         },
+					{ "p50_us"s,     json::Node(Median(std::move(p50_us)))          },
+					{ "p99_us"s,     json::Node(Median(std::move(p99_us)))          }
+				};
+			}
+
+			return {
+				{ "name"s,                json::Node(scenario.name)                              },
+				{ "params"s,              json::Node(ParamsToDict(scenario.params))              },
+				{ "input_kb"s,            json::Node(static_cast<int>(input.size() / 1024))       },
+				{ "phases_ms"s,           json::Node(std::move(phases))                          },
+				// Wall clock, the requests of a batch are answered together
+				{ "requests_per_second"s, json::Node(Median(std::move(requests_per_second)))     },
+				{ "queries"s,             json::Node(std::move(queries))                         }
+			};
+		}
+
+		template<typename Number>
+		bool ParseNumber(std::string_view text, Number& value) {
+			if constexpr (std::is_floating_point_v<Number>) {
+				// from_chars for double is missing in older standard libraries
+				std::istringstream in{ std::string(text) };
+				return static_cast<bool>(in >> value) && in.eof();
+			} else {
+				const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+				return error == std::errc() && end == text.data() + text.size();
+			}
+		}
+
+		// Returns false on an unknown option or a bad value
+		bool ParseOption(std::string_view arg, CityParams& params, size_t& repetitions, size_t& rounds, bool& has_city) {
+			const size_t eq = arg.find('=');
+			if (arg.substr(0, 2) != "--"sv || eq == std::string_view::npos) {
+				return false;
+			}
+			const std::string_view key   = arg.substr(2, eq - 2);
+			const std::string_view value = arg.substr(eq + 1);
+			if (key == "repetitions"sv) {
+				return ParseNumber(value, repetitions) && repetitions > 0;
+			} else if (key == "rounds"sv) {
+				return ParseNumber(value, rounds);
+			}
+			has_city = true;
+			if (key == "layout"sv) {
+				const std::optional<CityLayout> layout = ParseLayout(value);
+				if (layout) {
+					params.layout = *layout;
+				}
+				return layout.has_value();
+			} else if (key == "stops"sv) {
+				return ParseNumber(value, params.stop_count);
+			} else if (key == "buses"sv) {
+				return ParseNumber(value, params.bus_count);
+			} else if (key == "route-length"sv) {
+				return ParseNumber(value, params.route_length);
+			} else if (key == "roundtrip-ratio"sv) {
+				return ParseNumber(value, params.roundtrip_ratio);
+			} else if (key == "stat-requests"sv) {
+				return ParseNumber(value, params.stat_request_count);
+			} else if (key == "map-requests"sv) {
+				return ParseNumber(value, params.map_request_count);
+			} else if (key == "seed"sv) {
+				return ParseNumber(value, params.seed);
+			}
+			return false;
+		}
+	}
+
+	std::vector<Scenario> GetDefaultScenarios() {
+		std::vector<Scenario> scenarios;
+		for (const CityLayout layout : { CityLayout::GRID, CityLayout::RADIAL, CityLayout::ORGANIC }) {
+			for (const size_t stop_count : { size_t(200), size_t(600) }) {
+				CityParams params;
+				params.layout             = layout;
+				params.stop_count         = stop_count;
+				params.bus_count          = stop_count / 10;
+				params.route_length       = 25;
+				params.stat_request_count = 5000;
+				scenarios.push_back({ std::string(LayoutToString(layout)) + '_' + std::to_string(stop_count), params });
+			}
+		}
+		return scenarios;
+	}
+
+	void RunBenchmarks(const std::vector<Scenario>& scenarios, size_t repetitions, std::ostream& out) {
+		json::Array results;
+		for (const Scenario& scenario : scenarios) {
+			results.emplace_back(RunScenario(scenario, repetitions));
+		}
+		json::Dict dict = {
+			{ "repetitions"s, json::Node(static_cast<int>(repetitions))  },
+			{ "peak_rss_kb"s, json::Node(static_cast<int>(profile::GetPeakRssKb())) },
+			{ "scenarios"s,   json::Node(std::move(results))             }
+		};
+		json::Print(json::Document(json::Node(std::move(dict))), out);
+		out << std::endl;
+	}
+
+	int RunCommand(const std::vector<std::string_view>& args, std::ostream& out, std::ostream& err) {
+		if (args.empty() || (args.front() != "benchmark"sv && args.front() != "generate"sv && args.front() != "check-updates"sv)) {
+			err << "Usage: benchmark [--repetitions=N] [city options] | generate [city options]"
+				" | check-updates [--rounds=N] [city options]"s << std::endl;
+			return 1;
+		}
+		CityParams params = args.front() == "check-updates"sv ? GetUpdateCheckCity() : CityParams();
+		size_t repetitions = DEFAULT_REPETITIONS;
+		size_t rounds      = DEFAULT_UPDATE_ROUNDS;
+		bool has_city = false;
+		for (size_t i = 1; i < args.size(); ++i) {
+			if (!ParseOption(args[i], params, repetitions, rounds, has_city)) {
+				err << "Bad option "s << args[i] << std::endl;
+				return 1;
+			}
+		}
+
+		if (args.front() == "generate"sv) {
+			json::Print(GenerateCity(params), out);
+			out << std::endl;
+		} else if (args.front() == "check-updates"sv) {
+			return CheckUpdates(params, rounds, out) == 0 ? 0 : 1;
+		} else if (has_city) {
+			RunBenchmarks({ { "custom"s, params } }, repetitions, out);
+		} else {
+			RunBenchmarks(GetDefaultScenarios(), repetitions, out);
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "city_generator.h"
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+	struct Scenario {
+		std::string name;
+		CityParams  params;
+	};
+
+	// Every layout at a small and a large size
+	std::vector<Scenario> GetDefaultScenarios();
+
+	// Runs every scenario the given number of times, each time from the serialized document into a new catalogue,
+	// and prints the medians of the phase times and of the query rates as JSON
+	void RunBenchmarks(const std::vector<Scenario>& scenarios, size_t repetitions, std::ostream& out);
+
+	// "benchmark [--repetitions=N] [city options]" runs the default scenarios, or only the given city if there are options.
+	// "generate [city options]" prints the input document of the city.
+	// "check-updates [--rounds=N] [city options]" compares the live router updates with rebuilds, see CheckUpdates.
+	// City options: --layout=grid|radial|organic --stops=N --buses=N --route-length=N --roundtrip-ratio=X
+	// --stat-requests=N --map-requests=N --seed=N. Returns the exit code of the process.
+	int RunCommand(const std::vector<std::string_view>& args, std::ostream& out, std::ostream& err);
+}
@@ -0,0 +1,313 @@
+#include "binary_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+namespace binary_reader {
+
+	using namespace domain;
+	using namespace std::literals;
+
+	namespace {
+
+		// In the order of RequestType
+		constexpr std::string_view REQUEST_TYPE_NAMES[] = { "Stop"sv, "Bus"sv, "Route"sv, "Map"sv };
+
+		// The frame is intact, only its payload can't be answered
+		class BadRequest
+			: public std::runtime_error {
+		public:
+			using runtime_error::runtime_error;
+		};
+
+		class PayloadReader {
+		public:
+			explicit PayloadReader(std::string_view data)
+				: data_(data)
+			{}
+
+			std::uint8_t ReadUint8() {
+				return static_cast<std::uint8_t>(ReadLittleEndian(1));
+			}
+
+			std::uint32_t ReadUint32() {
+				return static_cast<std::uint32_t>(ReadLittleEndian(4));
+			}
+
+			std::int32_t ReadInt32() {
+				return static_cast<std::int32_t>(ReadUint32());
+			}
+
+			double ReadDouble() {
+				const std::uint64_t bits = ReadLittleEndian(8);
+				double value;
+				std::memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+
+			// Refers to the payload
+			std::string_view ReadString() {
+				return Take(ReadUint32());
+			}
+
+			// Called once the fields are read, before any work is done for the request
+			void ExpectEnd() const {
+				if (pos_ != data_.size()) {
+					throw BadRequest("The payload is too long"s);
+				}
+			}
+
+		private:
+			std::string_view data_;
+			size_t           pos_ = 0;
+
+			std::string_view Take(size_t size) {
+				if (data_.size() - pos_ < size) {
+					throw BadRequest("The payload is too short"s);
+				}
+				const std::string_view result = data_.substr(pos_, size);
+				pos_ += size;
+				return result;
+			}
+
+			std::uint64_t ReadLittleEndian(size_t size) {
+				const std::string_view bytes = Take(size);
+				std::uint64_t value = 0;
+				for (size_t i = 0; i < size; ++i) {
+					value |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+				}
+				return value;
+			}
+		};
+
+		void WriteLittleEndian(std::string& out, std::uint64_t value, size_t size) {
+			for (size_t i = 0; i < size; ++i) {
+				out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+			}
+		}
+
+		void WriteUint8(std::string& out, std::uint8_t value) {
+			WriteLittleEndian(out, value, 1);
+		}
+
+		void WriteUint32(std::string& out, std::uint32_t value) {
+			WriteLittleEndian(out, value, 4);
+		}
+
+		void WriteInt32(std::string& out, std::int32_t value) {
+			WriteUint32(out, static_cast<std::uint32_t>(value));
+		}
+
+		void WriteDouble(std::string& out, double value) {
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			WriteLittleEndian(out, bits, 8);
+		}
+
+		void WriteString(std::string& out, std::string_view value) {
+			WriteUint32(out, static_cast<std::uint32_t>(value.size()));
+			out.append(value);
+		}
+
+		transport::RoutePoint ReadRoutePoint(PayloadReader& request) {
+			switch (static_cast<PointKind>(request.ReadUint8())) {
+			case PointKind::STOP:
+				return request.ReadString();
+			case PointKind::COORDINATES: {
+				const double latitude  = request.ReadDouble();
+				const double longitude = request.ReadDouble();
+				return geo::Coordinates{ latitude, longitude };
+			}
+			}
+			throw BadRequest("Unknown point kind"s);
+		}
+
+		Status WriteStop(const request_handler::RequestHandler& rh, std::string_view stop_name, std::string& body) {
+			const auto stop_stat = rh.GetStopStat(stop_name);
+			if (!stop_stat) {
+				return Status::NOT_FOUND;
+			}
+			std::vector<std::string_view> bus_names;
+			if (stop_stat->passing_buses) {
+				bus_names.reserve(stop_stat->passing_buses->size());
+				for (const BusPtr& bus : *stop_stat->passing_buses) {
+					bus_names.push_back(bus->name);
+				}
+			}
+			std::sort(bus_names.begin(), bus_names.end());
+
+			WriteUint32(body, static_cast<std::uint32_t>(bus_names.size()));
+			for (const std::string_view name : bus_names) {
+				WriteString(body, name);
+			}
+			return Status::OK;
+		}
+
+		Status WriteBus(const request_handler::RequestHandler& rh, std::string_view bus_name, std::string& body) {
+			const auto bus_stat = rh.GetBusStat(bus_name);
+			if (!bus_stat) {
+				return Status::NOT_FOUND;
+			}
+			WriteDouble(body, bus_stat->curvature);
+			WriteInt32(body, bus_stat->routh_actual_length);
+			WriteInt32(body, bus_stat->stops_on_route);
+			WriteInt32(body, bus_stat->unique_stops);
+			return Status::OK;
+		}
+
+		Status WriteRoute(const request_handler::RequestHandler& rh, const transport::RoutePoint& from, const transport::RoutePoint& to, std::string& body) {
+			const auto route_info = rh.GetRouteInfo(from, to);
+			if (!route_info) {
+				return Status::NOT_FOUND;
+			}
+
+			WriteDouble(body, route_info->total_time);
+			WriteUint32(body, static_cast<std::uint32_t>(route_info->items.size()));
+			for (const transport::RouteItem& item : route_info->items) {
+				if (item.wait_item) {
+					WriteUint8(body, static_cast<std::uint8_t>(RouteItemKind::WAIT));
+					WriteString(body, item.wait_item->stop_name);
+					WriteDouble(body, item.wait_item->time);
+				} else if (item.walk_item) {
+					WriteUint8(body, static_cast<std::uint8_t>(RouteItemKind::WALK));
+					WriteUint8(body, item.walk_item->stop_name ? 1 : 0);
+					if (item.walk_item->stop_name) {
+						WriteString(body, *item.walk_item->stop_name);
+					}
+					WriteDouble(body, item.walk_item->distance);
+					WriteDouble(body, item.walk_item->time);
+				} else {
+					WriteUint8(body, static_cast<std::uint8_t>(RouteItemKind::BUS));
+					WriteString(body, item.bus_item->bus_name);
+					WriteInt32(body, item.bus_item->span_count);
+					WriteDouble(body, item.bus_item->time);
+				}
+			}
+			return Status::OK;
+		}
+
+		Status WriteMap(const request_handler::RequestHandler& rh, std::string& body) {
+			std::ostringstream out;
+			rh.RenderMap().Render(out);
+			WriteString(body, out.str());
+			return Status::OK;
+		}
+
+		// The body is written with the OK status only
+		std::string MakeResponse(std::int32_t id, Status status, std::string_view body) {
+			std::string response;
+			response.reserve(5 + body.size());
+			WriteInt32(response, id);
+			WriteUint8(response, static_cast<std::uint8_t>(status));
+			if (status == Status::OK) {
+				response += body;
+			}
+			return response;
+		}
+	}
+
+	std::vector<std::string> GetRequestTypes() {
+		return std::vector<std::string>(std::begin(REQUEST_TYPE_NAMES), std::end(REQUEST_TYPE_NAMES));
+	}
+
+	BinaryReader::BinaryReader(request_handler::RequestHandler& req_handler)
+		: rh_(req_handler)
+	{}
+
+	void BinaryReader::Start(std::istream& input, std::ostream& out) {
+		profile::LatencyRecorder latency = profile::LatencyRecorder::FromEnvironment(GetRequestTypes());
+		Start(input, out, latency);
+		latency.Report();
+	}
+
+	void BinaryReader::Start(std::istream& input, std::ostream& out, profile::LatencyRecorder& latency) {
+		latency.RestartClock();
+
+		std::string request;
+		std::string frame;
+		while (true) {
+			char size_bytes[4];
+			input.read(size_bytes, sizeof(size_bytes));
+			if (input.gcount() == 0) {
+				break;
+			}
+			if (input.gcount() != sizeof(size_bytes)) {
+				throw ProtocolError("Truncated frame size"s);
+			}
+			const std::uint32_t size = PayloadReader(std::string_view(size_bytes, sizeof(size_bytes))).ReadUint32();
+			if (size > MAX_FRAME_SIZE) {
+				throw ProtocolError("Frame of "s + std::to_string(size) + " bytes is too large"s);
+			}
+			request.resize(size);
+			input.read(request.data(), size);
+			if (static_cast<size_t>(input.gcount()) != size) {
+				throw ProtocolError("Truncated frame"s);
+			}
+
+			const std::string response = Answer(request, latency);
+			frame.clear();
+			WriteUint32(frame, static_cast<std::uint32_t>(response.size()));
+			frame += response;
+			out.write(frame.data(), frame.size());
+			if (input.rdbuf()->in_avail() <= 0) {
+				out.flush();
+			}
+		}
+		out.flush();
+	}
+
+	std::string BinaryReader::Answer(std::string_view request, profile::LatencyRecorder& latency) const {
+		PayloadReader reader(request);
+		std::uint8_t type = 0;
+		std::int32_t id   = 0;
+		try {
+			type = reader.ReadUint8();
+			id   = reader.ReadInt32();
+		} catch (const BadRequest&) {
+			// The frame is intact, so the stream goes on, but there is no id to answer with
+			return MakeResponse(0, Status::BAD_REQUEST, {});
+		}
+		// Unknown types are past the type names and are not timed
+		auto timer = latency.StartTimer(static_cast<size_t>(type));
+
+		std::string body;
+		Status status = Status::BAD_REQUEST;
+		try {
+			// An unknown type keeps the BAD_REQUEST status
+			switch (static_cast<RequestType>(type)) {
+			case RequestType::STOP: {
+				const std::string_view stop_name = reader.ReadString();
+				reader.ExpectEnd();
+				status = WriteStop(rh_, stop_name, body);
+				break;
+			}
+			case RequestType::BUS: {
+				const std::string_view bus_name = reader.ReadString();
+				reader.ExpectEnd();
+				status = WriteBus(rh_, bus_name, body);
+				break;
+			}
+			case RequestType::ROUTE: {
+				const transport::RoutePoint from = ReadRoutePoint(reader);
+				const transport::RoutePoint to   = ReadRoutePoint(reader);
+				reader.ExpectEnd();
+				status = WriteRoute(rh_, from, to, body);
+				break;
+			}
+			case RequestType::MAP:
+				reader.ExpectEnd();
+				status = WriteMap(rh_, body);
+				break;
+			}
+		} catch (const BadRequest&) {
+			status = Status::BAD_REQUEST;
+		}
+
+		std::string response = MakeResponse(id, status, body);
+		timer.Stop();
+
+		return response;
+	}
+}
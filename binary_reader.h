@@ -0,0 +1,85 @@
+#pragma once
+
+#include "latency_recorder.h"
+#include "request_handler.h"
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace binary_reader {
+
+	// A stream of frames: a uint32 payload size and the payload. Integers are little-endian, doubles are
+	// IEEE 754 binary64 stored as a little-endian uint64, a string is a uint32 size and the bytes.
+	//
+	// Request payload: uint8 type, int32 id, then by the type
+	//   STOP, BUS  string name
+	//   ROUTE      point from, point to: uint8 0 and a string stop name, or uint8 1 and double latitude, longitude
+	//   MAP        nothing
+	//
+	// Response payload: int32 id, uint8 status, then by the type of the request if the status is OK
+	//   STOP   uint32 count and the names of the passing buses in the name order
+	//   BUS    double curvature, int32 route length, int32 stop count, int32 unique stop count
+	//   ROUTE  double total time, uint32 count and the items, each is uint8 kind and
+	//          WAIT: string stop name, double time
+	//          BUS:  string bus name, int32 span count, double time
+	//          WALK: uint8 1 and string stop name or uint8 0, double distance, double time
+	//   MAP    string SVG
+	enum class RequestType : std::uint8_t {
+		STOP  = 0,
+		BUS   = 1,
+		ROUTE = 2,
+		MAP   = 3,
+	};
+
+	enum class Status : std::uint8_t {
+		OK          = 0,
+		NOT_FOUND   = 1,
+		// An unknown type, a payload too short or too long for its type. A payload without the type and the id
+		// is answered with id 0.
+		BAD_REQUEST = 2,
+	};
+
+	enum class RouteItemKind : std::uint8_t {
+		WAIT = 0,
+		BUS  = 1,
+		WALK = 2,
+	};
+
+	enum class PointKind : std::uint8_t {
+		STOP        = 0,
+		COORDINATES = 1,
+	};
+
+	// The stream can't be split into frames any more
+	class ProtocolError
+		: public std::runtime_error {
+	public:
+		using runtime_error::runtime_error;
+	};
+
+	// The types of the requests as the latencies are recorded, in the order of RequestType
+	std::vector<std::string> GetRequestTypes();
+
+	class BinaryReader final {
+	public:
+		static constexpr std::uint32_t MAX_FRAME_SIZE = 1u << 26;
+
+		BinaryReader(request_handler::RequestHandler& req_handler);
+
+		// Answers the frames in order until the input ends. The responses are flushed whenever no more requests
+		// are buffered, so a client may send the next requests without waiting.
+		// Records the latencies as configured by the environment.
+		void Start(std::istream& input, std::ostream& out);
+		void Start(std::istream& input, std::ostream& out, profile::LatencyRecorder& latency);
+
+		// The response payload of a request payload
+		std::string Answer(std::string_view request, profile::LatencyRecorder& latency) const;
+
+	private:
+		request_handler::RequestHandler& rh_;
+	};
+}
@@ -0,0 +1,329 @@
+#define _USE_MATH_DEFINES
+#include "city_generator.h"
+#include "geo.h"
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+	using namespace std::literals;
+
+	namespace {
+
+		// Stops are placed in meters around the center, a degree of longitude is shorter at its latitude
+		constexpr double CENTER_LAT          = 55.75;
+		constexpr double CENTER_LNG          = 37.62;
+		constexpr double METERS_PER_LAT      = 111195.;
+		constexpr double METERS_PER_LNG      = 62575.;
+		constexpr double STOP_SPACING        = 400.;
+		constexpr double CLUSTER_RADIUS      = 1500.;
+		constexpr size_t STOPS_PER_CLUSTER   = 200;
+		constexpr size_t ORGANIC_NEIGHBORS   = 4;
+		constexpr double MIN_ROAD_DETOUR     = 1.1;
+		constexpr double MAX_ROAD_DETOUR     = 1.4;
+
+		struct Point {
+			double x;
+			double y;
+		};
+
+		// The distributions of <random> are implementation-defined, so the numbers are made from the raw engine output
+		class Random {
+		public:
+			explicit Random(std::uint64_t seed)
+				: engine_(seed)
+			{}
+
+			// In [0, 1)
+			double NextDouble() {
+				return static_cast<double>(engine_() >> 11) / 9007199254740992.;
+			}
+			double NextDouble(double min, double max) {
+				return min + (max - min) * NextDouble();
+			}
+			// In [0, count)
+			size_t NextIndex(size_t count) {
+				return static_cast<size_t>(engine_() % count);
+			}
+
+		private:
+			std::mt19937_64 engine_;
+		};
+
+		struct City {
+			std::vector<Point>               stops;
+			std::vector<std::vector<size_t>> neighbors;
+		};
+
+		void Connect(City& city, size_t lhs, size_t rhs) {
+			if (lhs == rhs || std::count(city.neighbors[lhs].begin(), city.neighbors[lhs].end(), rhs)) {
+				return;
+			}
+			city.neighbors[lhs].push_back(rhs);
+			city.neighbors[rhs].push_back(lhs);
+		}
+
+		City MakeGridCity(size_t stop_count) {
+			City city{ std::vector<Point>(stop_count), std::vector<std::vector<size_t>>(stop_count) };
+			const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(stop_count))));
+			for (size_t i = 0; i < stop_count; ++i) {
+				const size_t row = i / side;
+				const size_t col = i % side;
+				city.stops[i] = { (col - side / 2.) * STOP_SPACING, (row - side / 2.) * STOP_SPACING };
+				if (col > 0) {
+					Connect(city, i, i - 1);
+				}
+				if (row > 0) {
+					Connect(city, i, i - side);
+				}
+			}
+
+			return city;
+		}
+
+		City MakeRadialCity(size_t stop_count) {
+			City city{ std::vector<Point>(stop_count), std::vector<std::vector<size_t>>(stop_count) };
+			const size_t ray_count = std::max<size_t>(4, static_cast<size_t>(std::sqrt(static_cast<double>(stop_count))));
+			for (size_t i = 0; i < stop_count; ++i) {
+				const size_t ring  = i / ray_count;
+				const size_t ray   = i % ray_count;
+				const double angle = 2. * M_PI * ray / ray_count;
+				const double radius = (ring + 1) * STOP_SPACING;
+				city.stops[i] = { radius * std::cos(angle), radius * std::sin(angle) };
+				if (ring > 0) {
+					Connect(city, i, i - ray_count);
+				}
+				if (ray > 0) {
+					Connect(city, i, i - 1);
+				}
+				if (ray + 1 == ray_count) {
+					Connect(city, i, i + 1 - ray_count);
+				}
+			}
+
+			return city;
+		}
+
+		City MakeOrganicCity(size_t stop_count, Random& random) {
+			City city{ std::vector<Point>(stop_count), std::vector<std::vector<size_t>>(stop_count) };
+			const size_t cluster_count = std::max<size_t>(1, stop_count / STOPS_PER_CLUSTER);
+			const double extent = std::sqrt(static_cast<double>(cluster_count)) * 2. * CLUSTER_RADIUS;
+			std::vector<std::pair<Point, double>> clusters(cluster_count);
+			for (auto& [center, radius] : clusters) {
+				center = { random.NextDouble(-extent, extent) / 2., random.NextDouble(-extent, extent) / 2. };
+				radius = random.NextDouble(0.3, 1.) * CLUSTER_RADIUS;
+			}
+			for (Point& stop : city.stops) {
+				const auto& [center, radius] = clusters[random.NextIndex(cluster_count)];
+				// A sum of uniform offsets is denser in the middle of a cluster, as a city center is
+				const double dx = random.NextDouble() + random.NextDouble() + random.NextDouble() - 1.5;
+				const double dy = random.NextDouble() + random.NextDouble() + random.NextDouble() - 1.5;
+				stop = { center.x + dx * radius, center.y + dy * radius };
+			}
+
+			std::vector<geo::Coordinates> coordinates;
+			coordinates.reserve(stop_count);
+			for (const Point& stop : city.stops) {
+				coordinates.push_back({ stop.y, stop.x });
+			}
+			const spatial::PointIndex index(coordinates);
+			for (size_t i = 0; i < stop_count; ++i) {
+				for (const spatial::Neighbor& neighbor : index.FindNearest(coordinates[i], ORGANIC_NEIGHBORS + 1)) {
+					Connect(city, i, neighbor.id);
+				}
+			}
+
+			return city;
+		}
+
+		// A walk over the neighbors which avoids the stops it has passed while it can
+		std::vector<size_t> MakeRoute(const City& city, size_t length, Random& random) {
+			std::vector<size_t> route = { random.NextIndex(city.stops.size()) };
+			std::vector<bool> is_visited(city.stops.size());
+			is_visited[route.back()] = true;
+			while (route.size() < length) {
+				const std::vector<size_t>& neighbors = city.neighbors[route.back()];
+				if (neighbors.empty()) {
+					break;
+				}
+				std::vector<size_t> candidates;
+				for (const size_t neighbor : neighbors) {
+					if (!is_visited[neighbor]) {
+						candidates.push_back(neighbor);
+					}
+				}
+				const std::vector<size_t>& choice = candidates.empty() ? neighbors : candidates;
+				route.push_back(choice[random.NextIndex(choice.size())]);
+				is_visited[route.back()] = true;
+			}
+
+			return route;
+		}
+
+		std::string StopName(size_t id) {
+			return "Stop "s + std::to_string(id);
+		}
+
+		std::string BusName(size_t id) {
+			return "Bus "s + std::to_string(id);
+		}
+
+		json::Dict MakeRoutingSettings() {
+			return {
+				{ "bus_wait_time"s, json::Node(6)   },
+				{ "bus_velocity"s,  json::Node(40.) }
+			};
+		}
+
+		json::Dict MakeRenderSettings() {
+			return {
+				{ "width"s,                json::Node(1200.)                                              },
+				{ "height"s,               json::Node(1200.)                                              },
+				{ "padding"s,              json::Node(50.)                                                },
+				{ "stop_radius"s,          json::Node(3.)                                                 },
+				{ "line_width"s,           json::Node(8.)                                                 },
+				{ "bus_label_font_size"s,  json::Node(14)                                                 },
+				{ "bus_label_offset"s,     json::Node(json::Array{ json::Node(7.), json::Node(15.) })     },
+				{ "stop_label_font_size"s, json::Node(12)                                                 },
+				{ "stop_label_offset"s,    json::Node(json::Array{ json::Node(7.), json::Node(-3.) })     },
+				{ "underlayer_color"s,     json::Node(json::Array{ json::Node(255), json::Node(255), json::Node(255), json::Node(0.85) }) },
+				{ "underlayer_width"s,     json::Node(3.)                                                 },
+				{ "color_palette"s,        json::Node(json::Array{ json::Node("green"s), json::Node("red"s), json::Node("blue"s) }) }
+			};
+		}
+	}
+
+	std::string_view LayoutToString(CityLayout layout) {
+		switch (layout) {
+		case CityLayout::GRID:
+			return "grid"sv;
+		case CityLayout::RADIAL:
+			return "radial"sv;
+		case CityLayout::ORGANIC:
+			return "organic"sv;
+		}
+		return {};
+	}
+
+	std::optional<CityLayout> ParseLayout(std::string_view name) {
+		for (const CityLayout layout : { CityLayout::GRID, CityLayout::RADIAL, CityLayout::ORGANIC }) {
+			if (LayoutToString(layout) == name) {
+				return layout;
+			}
+		}
+		return std::nullopt;
+	}
+
+	json::Document GenerateCity(const CityParams& params) {
+		Random random(params.seed);
+		const size_t stop_count = std::max<size_t>(2, params.stop_count);
+		City city;
+		switch (params.layout) {
+		case CityLayout::GRID:
+			city = MakeGridCity(stop_count);
+			break;
+		case CityLayout::RADIAL:
+			city = MakeRadialCity(stop_count);
+			break;
+		case CityLayout::ORGANIC:
+			city = MakeOrganicCity(stop_count, random);
+			break;
+		}
+
+		// Every pair of adjacent stops of a route gets a road a bit longer than the straight line
+		std::map<std::pair<size_t, size_t>, int> road_distances;
+		auto add_road = [&city, &random, &road_distances](size_t from, size_t to) {
+			if (road_distances.count({ from, to })) {
+				return;
+			}
+			const double length = std::hypot(city.stops[from].x - city.stops[to].x, city.stops[from].y - city.stops[to].y);
+			road_distances[{ from, to }] = std::max(1, static_cast<int>(std::ceil(length * random.NextDouble(MIN_ROAD_DETOUR, MAX_ROAD_DETOUR))));
+		};
+
+		json::Array base_requests;
+		std::vector<json::Dict> bus_requests;
+		for (size_t bus = 0; bus < params.bus_count; ++bus) {
+			std::vector<size_t> route = MakeRoute(city, std::max<size_t>(2, params.route_length), random);
+			const bool is_roundtrip = random.NextDouble() < params.roundtrip_ratio;
+			if (is_roundtrip) {
+				route.push_back(route.front());
+			}
+			json::Array stops;
+			for (size_t i = 0; i < route.size(); ++i) {
+				stops.push_back(json::Node(StopName(route[i])));
+				if (i > 0) {
+					add_road(route[i - 1], route[i]);
+				}
+			}
+			bus_requests.push_back({
+				{ "type"s,         json::Node("Bus"s)            },
+				{ "name"s,         json::Node(BusName(bus))      },
+				{ "stops"s,        json::Node(std::move(stops))  },
+				{ "is_roundtrip"s, json::Node(is_roundtrip)      }
+			});
+		}
+
+		std::vector<json::Dict> stops_road_distances(stop_count);
+		for (const auto& [stops, distance] : road_distances) {
+			stops_road_distances[stops.first][StopName(stops.second)] = json::Node(distance);
+		}
+		for (size_t i = 0; i < stop_count; ++i) {
+			base_requests.push_back(json::Dict{
+				{ "type"s,           json::Node("Stop"s)                                        },
+				{ "name"s,           json::Node(StopName(i))                                    },
+				{ "latitude"s,       json::Node(CENTER_LAT + city.stops[i].y / METERS_PER_LAT)  },
+				{ "longitude"s,      json::Node(CENTER_LNG + city.stops[i].x / METERS_PER_LNG)  },
+				{ "road_distances"s, json::Node(std::move(stops_road_distances[i]))             }
+			});
+		}
+		for (json::Dict& bus_request : bus_requests) {
+			base_requests.push_back(std::move(bus_request));
+		}
+
+		json::Array stat_requests;
+		for (size_t i = 0; i < params.stat_request_count; ++i) {
+			const int id = static_cast<int>(stat_requests.size()) + 1;
+			const size_t kind = random.NextIndex(10);
+			if (kind < 4) {
+				stat_requests.push_back(json::Dict{
+					{ "id"s,   json::Node(id)                                         },
+					{ "type"s, json::Node("Route"s)                                   },
+					{ "from"s, json::Node(StopName(random.NextIndex(stop_count)))     },
+					{ "to"s,   json::Node(StopName(random.NextIndex(stop_count)))     }
+				});
+			} else if (kind < 7 || params.bus_count == 0) {
+				stat_requests.push_back(json::Dict{
+					{ "id"s,   json::Node(id)                                         },
+					{ "type"s, json::Node("Stop"s)                                    },
+					{ "name"s, json::Node(StopName(random.NextIndex(stop_count)))     }
+				});
+			} else {
+				stat_requests.push_back(json::Dict{
+					{ "id"s,   json::Node(id)                                         },
+					{ "type"s, json::Node("Bus"s)                                     },
+					{ "name"s, json::Node(BusName(random.NextIndex(params.bus_count))) }
+				});
+			}
+		}
+		for (size_t i = 0; i < params.map_request_count; ++i) {
+			stat_requests.push_back(json::Dict{
+				{ "id"s,   json::Node(static_cast<int>(stat_requests.size()) + 1) },
+				{ "type"s, json::Node("Map"s)                                     }
+			});
+		}
+
+		return json::Document(json::Node(json::Dict{
+			{ "base_requests"s,    json::Node(std::move(base_requests)) },
+			{ "stat_requests"s,    json::Node(std::move(stat_requests)) },
+			{ "routing_settings"s, json::Node(MakeRoutingSettings())    },
+			{ "render_settings"s,  json::Node(MakeRenderSettings())     }
+		}));
+	}
+}
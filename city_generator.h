@@ -0,0 +1,38 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace bench {
+
+	enum class CityLayout {
+		GRID,
+		RADIAL,
+		// Clusters of stops of different density joined to their nearest neighbors, as real cities are
+		ORGANIC,
+	};
+
+	std::string_view          LayoutToString(CityLayout layout);
+	std::optional<CityLayout> ParseLayout(std::string_view name);
+
+	struct CityParams {
+		CityLayout    layout             = CityLayout::GRID;
+		size_t        stop_count         = 1000;
+		size_t        bus_count          = 50;
+		// Stops a bus passes before it turns back or closes the ring
+		size_t        route_length       = 20;
+		double        roundtrip_ratio    = 0.5;
+		// Route, Stop and Bus requests in the proportion 4:3:3, then map_request_count Map requests
+		size_t        stat_request_count = 1000;
+		size_t        map_request_count  = 1;
+		std::uint64_t seed               = 1;
+	};
+
+	// A complete input document: base, stat, routing and render requests.
+	// Equal parameters give equal documents: the numbers come from the raw output of std::mt19937_64,
+	// not from the implementation-defined distributions.
+	json::Document GenerateCity(const CityParams& params);
+}
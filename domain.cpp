@@ -5,8 +5,8 @@
 
 namespace domain {
 
-	Stop::Stop(std::string&& f_name, double f_lat, double f_long)
-		: name(std::make_shared<std::string>(std::move(f_name)))
+	Stop::Stop(std::string_view f_name, double f_lat, double f_long)
+		: name(f_name)
 		, latitude(f_lat)
 		, longitude(f_long)
 	{}
@@ -18,8 +18,8 @@ namespace domain {
 		);
 	}
 
-	Bus::Bus(std::string&& f_name, std::vector<StopPtr>&& f_route, int f_unique, int f_actual, double f_geogr, StopPtr last_stop)
-		: name(std::make_shared<std::string>(std::move(f_name)))
+	Bus::Bus(std::string_view f_name, std::vector<StopPtr>&& f_route, int f_unique, int f_actual, double f_geogr, StopPtr last_stop)
+		: name(f_name)
 		, route(std::vector<StopPtr>(std::move(f_route)))
 		, unique_stops(f_unique)
 		, route_actual_length(f_actual)
@@ -16,11 +16,13 @@ namespace domain {
 	using StopPtr = std::shared_ptr<Stop>;
 
 	struct Bus final {
-		Bus(std::string&& f_name, std::vector<StopPtr>&& f_route, int f_unique, int f_actual, double f_geogr, StopPtr last_stop = nullptr);
+		Bus() = default;
+		Bus(std::string_view f_name, std::vector<StopPtr>&& f_route, int f_unique, int f_actual, double f_geogr, StopPtr last_stop = nullptr);
 
 		Bus& operator=(const Bus& bus) = default;
 
-		std::shared_ptr<std::string> name;
+		// Interned by the catalogue the bus is added to
+		std::string_view name;
 		std::vector<StopPtr> route;
 		int unique_stops               = 0;
 		int route_actual_length        = 0;
@@ -29,15 +31,23 @@ namespace domain {
 	};
 
 	struct Stop final {
-		Stop(std::string&& f_name, double f_lat, double f_long);
+		Stop() = default;
+		Stop(std::string_view f_name, double f_lat, double f_long);
 
 		double GetGeographicDistanceTo(StopPtr stop_to) const;
 
-		std::shared_ptr<std::string> name;
+		// Interned by the catalogue the stop is added to
+		std::string_view name;
 		double latitude  = 0;
 		double longitude = 0;
 	};
 
+	struct RoadDistance final {
+		StopPtr from;
+		StopPtr to;
+		int     distance = 0;
+	};
+
 	struct BusStat final {
 		std::string_view name;
 		int stops_on_route      = 0;
@@ -48,7 +58,8 @@ namespace domain {
 
 	struct StopStat final {
 		std::string_view name;
-		const std::unordered_set<BusPtr>* passing_buses;
+		// Keeps alive the catalogue snapshot the set belongs to
+		std::shared_ptr<const std::unordered_set<BusPtr>> passing_buses;
 	};
 
 }
\ No newline at end of file
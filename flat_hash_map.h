@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONTAINERS_USE_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace containers {
+
+	namespace detail {
+
+		// A control byte is EMPTY or the lowest 7 bits of the hash of the slot's key
+		using Ctrl = std::int8_t;
+		constexpr Ctrl   EMPTY      = -128;
+		constexpr size_t GROUP_SIZE = 16;
+
+		inline std::uint64_t MixHash(std::uint64_t hash) {
+			// Pointer hashes are the addresses themselves, their low bits have to be mixed in
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		inline std::uint32_t CountTrailingZeros(std::uint32_t mask) {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return __builtin_ctz(mask);
+#endif
+		}
+
+		// Control bytes of GROUP_SIZE adjacent slots compared at once, bit i of a mask stands for the i-th slot
+		class Group {
+		public:
+			explicit Group(const Ctrl* ctrl) {
+#ifdef CONTAINERS_USE_SSE2
+				ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+				ctrl_ = ctrl;
+#endif
+			}
+
+			std::uint32_t Match(Ctrl h2) const {
+#ifdef CONTAINERS_USE_SSE2
+				return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+#else
+				std::uint32_t mask = 0;
+				for (size_t i = 0; i < GROUP_SIZE; ++i) {
+					mask |= static_cast<std::uint32_t>(ctrl_[i] == h2) << i;
+				}
+				return mask;
+#endif
+			}
+
+			std::uint32_t MatchEmpty() const {
+				return Match(EMPTY);
+			}
+
+		private:
+#ifdef CONTAINERS_USE_SSE2
+			__m128i ctrl_;
+#else
+			const Ctrl* ctrl_;
+#endif
+		};
+	}
+
+	// Open-addressing hash map in the Swiss table layout: a lookup compares a group of control bytes
+	// at once and touches a key only when 7 bits of its hash match. The full hash of every key is kept,
+	// so growing the table doesn't hash the keys again.
+	// Elements are never erased, which is all the indexes need. Key and Value must be default constructible.
+	template<typename Key, typename Value, typename Hash = std::hash<Key>>
+	class FlatHashMap {
+	public:
+		using value_type = std::pair<Key, Value>;
+
+	private:
+		template<bool IsConst>
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type        = FlatHashMap::value_type;
+			using difference_type   = std::ptrdiff_t;
+			using pointer           = std::conditional_t<IsConst, const value_type*, value_type*>;
+			using reference         = std::conditional_t<IsConst, const value_type&, value_type&>;
+			using Map               = std::conditional_t<IsConst, const FlatHashMap, FlatHashMap>;
+
+			Iterator() = default;
+			Iterator(Map* map, size_t index)
+				: map_(map)
+				, index_(index)
+			{
+				SkipEmpty();
+			}
+			// iterator converts to const_iterator
+			template<bool OtherIsConst, typename = std::enable_if_t<IsConst && !OtherIsConst>>
+			Iterator(const Iterator<OtherIsConst>& other)
+				: map_(other.map_)
+				, index_(other.index_)
+			{}
+
+			reference operator*()  const { return map_->slots_[index_]; }
+			pointer   operator->() const { return &map_->slots_[index_]; }
+
+			Iterator& operator++() {
+				++index_;
+				SkipEmpty();
+				return *this;
+			}
+			Iterator operator++(int) {
+				Iterator result = *this;
+				++*this;
+				return result;
+			}
+
+			bool operator==(const Iterator& other) const { return index_ == other.index_; }
+			bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+		private:
+			friend class FlatHashMap;
+			template<bool> friend class Iterator;
+
+			Map*   map_   = nullptr;
+			size_t index_ = 0;
+
+			void SkipEmpty() {
+				while (index_ < map_->slots_.size() && map_->ctrl_[index_] == detail::EMPTY) {
+					++index_;
+				}
+			}
+		};
+
+	public:
+		using iterator       = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		FlatHashMap() = default;
+		template<typename InputIt>
+		FlatHashMap(InputIt first, InputIt last) {
+			for (; first != last; ++first) {
+				emplace(first->first, first->second);
+			}
+		}
+
+		size_t size()  const { return size_; }
+		bool   empty() const { return size_ == 0; }
+
+		iterator       begin()       { return { this, 0 }; }
+		iterator       end()         { return { this, slots_.size() }; }
+		const_iterator begin() const { return { this, 0 }; }
+		const_iterator end()   const { return { this, slots_.size() }; }
+
+		iterator find(const Key& key) {
+			return { this, FindIndex(key) };
+		}
+		const_iterator find(const Key& key) const {
+			return { this, FindIndex(key) };
+		}
+		size_t count(const Key& key) const {
+			return FindIndex(key) != slots_.size() ? 1 : 0;
+		}
+
+		Value& at(const Key& key) {
+			return const_cast<Value&>(std::as_const(*this).at(key));
+		}
+		const Value& at(const Key& key) const {
+			const size_t index = FindIndex(key);
+			if (index == slots_.size()) {
+				throw std::out_of_range("FlatHashMap::at");
+			}
+			return slots_[index].second;
+		}
+
+		Value& operator[](const Key& key) {
+			if (const size_t index = FindIndex(key); index != slots_.size()) {
+				return slots_[index].second;
+			}
+			return emplace(key, Value{}).first->second;
+		}
+
+		// Does nothing if the key is present, as std::unordered_map::emplace
+		std::pair<iterator, bool> emplace(const Key& key, Value value) {
+			const std::uint64_t hash = detail::MixHash(hasher_(key));
+			if (const size_t index = FindIndex(key, hash); index != slots_.size()) {
+				return { iterator(this, index), false };
+			}
+			if ((size_ + 1) * 8 > slots_.size() * 7) {
+				Rehash(std::max(slots_.size() * 2, detail::GROUP_SIZE));
+			}
+			const size_t index = FindEmptyIndex(hash);
+			ctrl_[index]   = H2(hash);
+			hashes_[index] = hash;
+			slots_[index]  = { key, std::move(value) };
+			++size_;
+
+			return { iterator(this, index), true };
+		}
+
+		// Of the table itself, memory owned by the keys and the values is not counted
+		size_t GetMemoryUsage() const {
+			return ctrl_.capacity() * sizeof(detail::Ctrl) + hashes_.capacity() * sizeof(std::uint64_t)
+				+ slots_.capacity() * sizeof(value_type);
+		}
+
+		void reserve(size_t count) {
+			size_t capacity = detail::GROUP_SIZE;
+			while (capacity * 7 < count * 8) {
+				capacity *= 2;
+			}
+			if (capacity > slots_.size()) {
+				Rehash(capacity);
+			}
+		}
+
+	private:
+		// The capacity is a power of two and a multiple of GROUP_SIZE, groups are probed quadratically
+		std::vector<detail::Ctrl>  ctrl_;
+		// The mixed hash of the slot's key, read only when the table grows
+		std::vector<std::uint64_t> hashes_;
+		std::vector<value_type>    slots_;
+		size_t                     size_ = 0;
+		Hash                       hasher_;
+
+		static detail::Ctrl H2(std::uint64_t hash) {
+			return static_cast<detail::Ctrl>(hash & 0x7F);
+		}
+		static size_t H1(std::uint64_t hash) {
+			return static_cast<size_t>(hash >> 7);
+		}
+
+		size_t FindIndex(const Key& key) const {
+			return FindIndex(key, detail::MixHash(hasher_(key)));
+		}
+
+		// The capacity if the key is missing
+		size_t FindIndex(const Key& key, std::uint64_t hash) const {
+			if (slots_.empty()) {
+				return 0;
+			}
+			const size_t group_mask = slots_.size() / detail::GROUP_SIZE - 1;
+			size_t group = H1(hash) & group_mask;
+			for (size_t step = 1; ; ++step) {
+				const size_t offset = group * detail::GROUP_SIZE;
+				const detail::Group ctrl_group(&ctrl_[offset]);
+				for (std::uint32_t mask = ctrl_group.Match(H2(hash)); mask != 0; mask &= mask - 1) {
+					const size_t index = offset + detail::CountTrailingZeros(mask);
+					if (slots_[index].first == key) {
+						return index;
+					}
+				}
+				// Without erasing the probe sequence of a key never goes past an empty slot
+				if (ctrl_group.MatchEmpty() != 0 || step > group_mask) {
+					return slots_.size();
+				}
+				group = (group + step) & group_mask;
+			}
+		}
+
+		size_t FindEmptyIndex(std::uint64_t hash) const {
+			const size_t group_mask = slots_.size() / detail::GROUP_SIZE - 1;
+			size_t group = H1(hash) & group_mask;
+			for (size_t step = 1; ; ++step) {
+				const size_t offset = group * detail::GROUP_SIZE;
+				if (const std::uint32_t mask = detail::Group(&ctrl_[offset]).MatchEmpty(); mask != 0) {
+					return offset + detail::CountTrailingZeros(mask);
+				}
+				group = (group + step) & group_mask;
+			}
+		}
+
+		void Rehash(size_t capacity) {
+			std::vector<detail::Ctrl>  old_ctrl   = std::move(ctrl_);
+			std::vector<std::uint64_t> old_hashes = std::move(hashes_);
+			std::vector<value_type>    old_slots  = std::move(slots_);
+			ctrl_.assign(capacity, detail::EMPTY);
+			hashes_.assign(capacity, 0);
+			slots_.clear();
+			slots_.resize(capacity);
+
+			for (size_t i = 0; i < old_slots.size(); ++i) {
+				if (old_ctrl[i] == detail::EMPTY) {
+					continue;
+				}
+				const std::uint64_t hash = old_hashes[i];
+				const size_t index = FindEmptyIndex(hash);
+				ctrl_[index]   = H2(hash);
+				hashes_[index] = hash;
+				slots_[index]  = std::move(old_slots[i]);
+			}
+		}
+	};
+}
@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <vector>
 #include <utility>
+#include <unordered_map>
 
 namespace graph {
 
@@ -27,6 +28,8 @@ namespace graph {
 	public:
 		DirectedWeightedGraph() = default;
 		explicit DirectedWeightedGraph(size_t vertex_count);
+		// Edge ids are the positions, the incidence lists are sized before they are filled
+		DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>>&& edges);
 
 		EdgeId AddEdge(const Edge<Weight>& edge);
 		EdgeId AddEdge(Edge<Weight>&& edge);
@@ -36,6 +39,9 @@ namespace graph {
 		const Edge<Weight>& GetEdge(EdgeId edge_id)           const;
 		IncidentEdgesRange  GetIncidentEdges(VertexId vertex) const;
 
+		size_t              GetEdgesMemoryUsage()             const;
+		size_t              GetIncidenceListsMemoryUsage()    const;
+
 	private:
 		std::vector<Edge<Weight>>  edges_;
 		std::vector<IncidenceList> incidence_lists_;
@@ -46,6 +52,23 @@ namespace graph {
 		: incidence_lists_(vertex_count) 
 	{}
 
+	template<typename Weight>
+	DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>>&& edges)
+		: edges_(std::move(edges))
+		, incidence_lists_(vertex_count)
+	{
+		std::vector<size_t> degrees(vertex_count, 0);
+		for (const auto& edge : edges_) {
+			++degrees.at(edge.from);
+		}
+		for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+			incidence_lists_[vertex].reserve(degrees[vertex]);
+		}
+		for (EdgeId id = 0; id < edges_.size(); ++id) {
+			incidence_lists_[edges_[id].from].push_back(id);
+		}
+	}
+
 	template<typename Weight>
 	EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
 		edges_.push_back(edge);
@@ -85,4 +108,111 @@ namespace graph {
 
 		return ranges::AsRange(incidence_lists_.at(vertex));
 	}
+
+	template<typename Weight>
+	size_t DirectedWeightedGraph<Weight>::GetEdgesMemoryUsage() const {
+		return edges_.capacity() * sizeof(Edge<Weight>);
+	}
+
+	template<typename Weight>
+	size_t DirectedWeightedGraph<Weight>::GetIncidenceListsMemoryUsage() const {
+		size_t result = incidence_lists_.capacity() * sizeof(IncidenceList);
+		for (const IncidenceList& list : incidence_lists_) {
+			result += list.capacity() * sizeof(EdgeId);
+		}
+		return result;
+	}
+
+	template<typename Weight, typename Func>
+	void ForEachIncidentEdge(const DirectedWeightedGraph<Weight>& graph, VertexId vertex, Func func) {
+		for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+			func(edge_id);
+		}
+	}
+
+	// Extra vertices and edges over a shared graph, the graph itself is not changed.
+	// Ids of the extra vertices and edges continue the ids of the graph.
+	template<typename Weight>
+	class GraphOverlay {
+	private:
+		using Graph = DirectedWeightedGraph<Weight>;
+
+	public:
+		explicit GraphOverlay(const Graph& graph);
+
+		VertexId AddVertex();
+		EdgeId   AddEdge(const Edge<Weight>& edge);
+
+		size_t              GetVertexCount()                  const;
+		size_t              GetEdgeCount()                    const;
+		bool                IsOverlayEdge(EdgeId edge_id)     const;
+		const Edge<Weight>& GetEdge(EdgeId edge_id)           const;
+
+		template<typename Func>
+		void ForEachIncidentEdge(VertexId vertex, Func func) const;
+
+	private:
+		const Graph& graph_;
+		size_t vertex_count_;
+		std::vector<Edge<Weight>> edges_;
+		std::unordered_map<VertexId, std::vector<EdgeId>> incidence_lists_;
+	};
+
+	template<typename Weight>
+	GraphOverlay<Weight>::GraphOverlay(const Graph& graph)
+		: graph_(graph)
+		, vertex_count_(graph.GetVertexCount())
+	{}
+
+	template<typename Weight>
+	VertexId GraphOverlay<Weight>::AddVertex() {
+		return vertex_count_++;
+	}
+
+	template<typename Weight>
+	EdgeId GraphOverlay<Weight>::AddEdge(const Edge<Weight>& edge) {
+		edges_.push_back(edge);
+		const EdgeId id = graph_.GetEdgeCount() + edges_.size() - 1;
+		incidence_lists_[edge.from].push_back(id);
+
+		return id;
+	}
+
+	template<typename Weight>
+	size_t GraphOverlay<Weight>::GetVertexCount() const {
+		return vertex_count_;
+	}
+
+	template<typename Weight>
+	size_t GraphOverlay<Weight>::GetEdgeCount() const {
+		return graph_.GetEdgeCount() + edges_.size();
+	}
+
+	template<typename Weight>
+	bool GraphOverlay<Weight>::IsOverlayEdge(EdgeId edge_id) const {
+		return edge_id >= graph_.GetEdgeCount();
+	}
+
+	template<typename Weight>
+	const Edge<Weight>& GraphOverlay<Weight>::GetEdge(EdgeId edge_id) const {
+		return IsOverlayEdge(edge_id) ? edges_.at(edge_id - graph_.GetEdgeCount()) : graph_.GetEdge(edge_id);
+	}
+
+	template<typename Weight>
+	template<typename Func>
+	void GraphOverlay<Weight>::ForEachIncidentEdge(VertexId vertex, Func func) const {
+		if (vertex < graph_.GetVertexCount()) {
+			graph::ForEachIncidentEdge(graph_, vertex, func);
+		}
+		if (const auto it = incidence_lists_.find(vertex); it != incidence_lists_.end()) {
+			for (const EdgeId edge_id : it->second) {
+				func(edge_id);
+			}
+		}
+	}
+
+	template<typename Weight, typename Func>
+	void ForEachIncidentEdge(const GraphOverlay<Weight>& graph, VertexId vertex, Func func) {
+		graph.ForEachIncidentEdge(vertex, func);
+	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <iterator>
 #include <cctype>
+#include <stdexcept>
 
 namespace json {
 
@@ -216,15 +217,25 @@ namespace json {
 			std::ostream& out;
 			int indent_step = 4;
 			int indent = 0;
+			bool is_compact = false;
 
 			void PrintIndent() const {
+				if (is_compact) {
+					return;
+				}
 				for (int i = 0; i < indent; ++i) {
 					out.put(' ');
 				}
 			}
 
+			void PrintLineBreak() const {
+				if (!is_compact) {
+					out.put('\n');
+				}
+			}
+
 			PrintContext Indented() const {
-				return { out, indent_step, indent_step + indent };
+				return { out, indent_step, indent_step + indent, is_compact };
 			}
 		};
 
@@ -276,19 +287,21 @@ namespace json {
 		template <>
 		void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
 			std::ostream& out = ctx.out;
-			out << "[\n"sv;
+			out.put('[');
+			ctx.PrintLineBreak();
 			bool first = true;
 			auto inner_ctx = ctx.Indented();
 			for (const Node& node : nodes) {
 				if (first) {
 					first = false;
 				} else {
-					out << ",\n"sv;
+					out.put(',');
+					ctx.PrintLineBreak();
 				}
 				inner_ctx.PrintIndent();
 				PrintNode(node, inner_ctx);
 			}
-			out.put('\n');
+			ctx.PrintLineBreak();
 			ctx.PrintIndent();
 			out.put(']');
 		}
@@ -296,21 +309,23 @@ namespace json {
 		template <>
 		void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
 			std::ostream& out = ctx.out;
-			out << "{\n"sv;
+			out.put('{');
+			ctx.PrintLineBreak();
 			bool first = true;
 			auto inner_ctx = ctx.Indented();
 			for (const auto& [key, node] : nodes) {
 				if (first) {
 					first = false;
 				} else {
-					out << ",\n"sv;
+					out.put(',');
+					ctx.PrintLineBreak();
 				}
 				inner_ctx.PrintIndent();
 				PrintString(key, ctx.out);
-				out << ": "sv;
+				out << (ctx.is_compact ? ":"sv : ": "sv);
 				PrintNode(node, inner_ctx);
 			}
-			out.put('\n');
+			ctx.PrintLineBreak();
 			ctx.PrintIndent();
 			out.put('}');
 		}
@@ -423,6 +438,15 @@ namespace json {
 		return !(lhs == rhs);
 	}
 
+	const Node& At(const Dict& dict, std::string_view key) {
+		const auto it = dict.find(key);
+		if (it == dict.end()) {
+			throw std::out_of_range(std::string(key));
+		}
+
+		return it->second;
+	}
+
 	Document::Document(Node root)
 		: root_(std::move(root)) {
 	}
@@ -447,4 +471,8 @@ namespace json {
 		PrintNode(doc.GetRoot(), PrintContext{ output });
 	}
 
+	void PrintCompact(const Document& doc, std::ostream& output) {
+		PrintNode(doc.GetRoot(), PrintContext{ output, 0, 0, true });
+	}
+
 }
\ No newline at end of file
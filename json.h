@@ -3,13 +3,15 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace json {
 
 	class Node;
-	using Dict  = std::map<std::string, Node>;
+	// Keys may be looked up by string_view without making a string
+	using Dict  = std::map<std::string, Node, std::less<>>;
 	using Array = std::vector<Node>;
 
 	class ParsingError
@@ -52,6 +54,9 @@ namespace json {
 
 	inline bool operator!=(const Node& lhs, const Node& rhs);
 
+	// Dict::at for a string_view key, throws std::out_of_range if there is no key
+	const Node& At(const Dict& dict, std::string_view key);
+
 	class Document {
 	public:
 		explicit Document(Node root);
@@ -68,4 +73,6 @@ namespace json {
 	Document Load(std::istream& input);
 
 	void Print(const Document& doc, std::ostream& output);
+	// On a single line, for the line-delimited output
+	void PrintCompact(const Document& doc, std::ostream& output);
 }
\ No newline at end of file
@@ -1,123 +1,481 @@
 #include "json_reader.h"
+#include "parallel.h"
 #include "transport_router.h"
 
 #include <utility>
+#include <unordered_map>
 #include <unordered_set>
 #include <set>
 #include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace json_reader {
 
 	using namespace domain;
 	using namespace std::literals;
 
+	namespace {
+
+		// In the order of the types, which is also the order of the latency types
+		constexpr std::string_view STAT_REQUEST_TYPE_NAMES[] = {
+			"Stop"sv, "Bus"sv, "Route"sv, "RouteMatrix"sv, "Reachable"sv, "NearestStops"sv, "StopsInBox"sv, "Stats"sv, "Map"sv
+		};
+		constexpr size_t STAT_REQUEST_TYPE_COUNT = std::size(STAT_REQUEST_TYPE_NAMES);
+
+		std::optional<StatRequestType> ParseStatRequestType(std::string_view name) {
+			for (size_t i = 0; i < STAT_REQUEST_TYPE_COUNT; ++i) {
+				if (STAT_REQUEST_TYPE_NAMES[i] == name) {
+					return static_cast<StatRequestType>(i);
+				}
+			}
+			return std::nullopt;
+		}
+
+		// The types reading the router, Stats reports its footprint
+		bool IsRouterRequest(StatRequestType type) {
+			return type == StatRequestType::ROUTE || type == StatRequestType::ROUTE_MATRIX
+				|| type == StatRequestType::REACHABLE || type == StatRequestType::STATS;
+		}
+
+		bool NeedsRouter(const json::Dict& dict) {
+			if (!dict.count("stat_requests"sv)) {
+				return false;
+			}
+			const json::Array& stat_requests = json::At(dict, "stat_requests"sv).AsArray();
+			return std::any_of(stat_requests.begin(), stat_requests.end(), [](const json::Node& req_node) {
+				const auto type = ParseStatRequestType(json::At(req_node.AsDict(), "type"sv).AsString());
+				return type && IsRouterRequest(*type);
+			});
+		}
+
+		// The searches between stops the stat requests take: a Route batch searches once per origin, a RouteMatrix
+		// once per row. The other router requests search the same whatever the backend.
+		size_t CountRouterSearches(const json::Dict& dict) {
+			std::unordered_set<std::string_view> route_origins;
+			size_t matrix_rows = 0;
+			for (const json::Node& req_node : json::At(dict, "stat_requests"sv).AsArray()) {
+				const json::Dict& req = req_node.AsDict();
+				const auto type = ParseStatRequestType(json::At(req, "type"sv).AsString());
+				if (type == StatRequestType::ROUTE && json::At(req, "from"sv).IsString() && json::At(req, "to"sv).IsString()) {
+					route_origins.insert(json::At(req, "from"sv).AsString());
+				} else if (type == StatRequestType::ROUTE_MATRIX) {
+					matrix_rows += json::At(req, "from"sv).AsArray().size();
+				}
+			}
+			return route_origins.size() + matrix_rows;
+		}
+
+		// Stop and Bus answers depend on the name only and Map answers on nothing,
+		// the requests of a type with the same key get the same answer. Routes between
+		// stops are answered once per pair by the route batch.
+		std::optional<std::string_view> GetAnswerKey(StatRequestType type, const json::Dict& req) {
+			if (type == StatRequestType::STOP || type == StatRequestType::BUS) {
+				return json::At(req, "name"sv).AsString();
+			} else if (type == StatRequestType::MAP) {
+				return ""sv;
+			}
+			return std::nullopt;
+		}
+
+		bool HasField(const json::Dict& req, std::string_view key, bool (json::Node::*is_kind)() const) {
+			const auto it = req.find(key);
+			return it != req.end() && (it->second.*is_kind)();
+		}
+
+		bool HasNumbers(const json::Dict& req, std::initializer_list<std::string_view> keys) {
+			return std::all_of(keys.begin(), keys.end(), [&req](std::string_view key) {
+				return HasField(req, key, &json::Node::IsDouble);
+			});
+		}
+
+		// A stop name or a point
+		bool HasRoutePoint(const json::Dict& req, std::string_view key) {
+			const auto it = req.find(key);
+			return it != req.end()
+				&& (it->second.IsString() || (it->second.IsDict() && HasNumbers(it->second.AsDict(), { "latitude"sv, "longitude"sv })));
+		}
+
+		bool HasStopNames(const json::Dict& req, std::string_view key) {
+			if (!HasField(req, key, &json::Node::IsArray)) {
+				return false;
+			}
+			const json::Array& names = json::At(req, key).AsArray();
+			return std::all_of(names.begin(), names.end(), [](const json::Node& name) {
+				return name.IsString();
+			});
+		}
+
+		// Null if the line is not JSON
+		json::Node ParseLine(const std::string& line) {
+			std::istringstream input(line);
+			try {
+				return json::Load(input).GetRoot();
+			} catch (const json::ParsingError&) {
+				return json::Node();
+			}
+		}
+
+		// Whether the request has the fields its type reads, so it can be answered
+		bool IsWellFormed(StatRequestType type, const json::Dict& req) {
+			switch (type) {
+			case StatRequestType::STOP:
+			case StatRequestType::BUS:
+				return HasField(req, "name"sv, &json::Node::IsString);
+			case StatRequestType::ROUTE:
+				return HasRoutePoint(req, "from"sv) && HasRoutePoint(req, "to"sv);
+			case StatRequestType::ROUTE_MATRIX:
+				return HasStopNames(req, "from"sv) && HasStopNames(req, "to"sv);
+			case StatRequestType::REACHABLE:
+				return HasField(req, "from"sv, &json::Node::IsString) && HasNumbers(req, { "max_time"sv });
+			case StatRequestType::NEAREST_STOPS:
+				return HasNumbers(req, { "latitude"sv, "longitude"sv }) && HasField(req, "count"sv, &json::Node::IsInt);
+			case StatRequestType::STOPS_IN_BOX:
+				return HasNumbers(req, { "min_latitude"sv, "min_longitude"sv, "max_latitude"sv, "max_longitude"sv });
+			case StatRequestType::STATS:
+			case StatRequestType::MAP:
+				break;
+			}
+			return true;
+		}
+
+		json::Node WithRequestId(const json::Node& answer, int id) {
+			json::Dict dict = answer.AsDict();
+			dict["request_id"s] = json::Node(id);
+
+			return json::Node(std::move(dict));
+		}
+	}
+
+	std::vector<std::string> GetStatRequestTypes() {
+		return std::vector<std::string>(std::begin(STAT_REQUEST_TYPE_NAMES), std::end(STAT_REQUEST_TYPE_NAMES));
+	}
+
 	JsonReader::JsonReader(request_handler::RequestHandler& req_handler)
 		: rh_(req_handler)
 	{}
 
 	void JsonReader::Start(std::istream& input, std::ostream& out) {
+		profile::Profiler        profiler = profile::Profiler::FromEnvironment();
+		profile::LatencyRecorder latency  = profile::LatencyRecorder::FromEnvironment(GetStatRequestTypes());
+		Start(input, out, profiler, latency);
+		profiler.Report();
+		latency.Report();
+	}
+
+	void JsonReader::Start(std::istream& input, std::ostream& out, profile::Profiler& profiler, profile::LatencyRecorder& latency) {
+		auto load_phase = profiler.StartPhase("load_json"sv);
 		const json::Document doc = json::Load(input);
 		const json::Node& node   = doc.GetRoot();
 		const json::Dict& dict   = node.AsDict();
+		load_phase.Finish();
 		
-		if (dict.count("routing_settings"s)) {
-			const auto [wait, vel] = ReadRoutingSettings(dict.at("routing_settings"s).AsDict());
-			rh_.SetRoutingSettings(wait, vel);
+		ApplySettings(dict);
+		if (dict.count("base_requests"s)) {
+			auto catalogue_phase = profiler.StartPhase("fill_catalogue"sv);
+			FillTransportCatalogue(dict);
+			if (profiler.IsEnabled()) {
+				catalogue_phase.AddCount("stops"sv, rh_.GetStopCount());
+				catalogue_phase.AddCount("buses"sv, rh_.GetBusCount());
+			}
+			catalogue_phase.Finish();
+
+			if (NeedsRouter(dict)) {
+				rh_.SetRouterExpectedQueryCount(CountRouterSearches(dict));
+				const bool is_profiled = profiler.IsEnabled();
+				router_build_ = std::async(std::launch::async, [this, is_profiled] {
+					return BuildRouter(is_profiled);
+				}).share();
+			}
+		}
+		if (dict.count("stat_requests"s)) {
+			auto stat_phase = profiler.StartPhase("stat_requests"sv);
+			AnswerStatRequests(dict, out, latency);
+			stat_phase.AddCount("requests"sv, dict.at("stat_requests"s).AsArray().size());
+			stat_phase.Finish();
+		}
+		if (router_build_.valid()) {
+			profiler.AddPhases(router_build_.get().GetPhases());
+			router_build_ = {};
+		}
+		if (profiler.IsEnabled() && dict.count("base_requests"s)) {
+			profiler.SetMemoryReport(rh_.GetMemoryReport());
+		}
+	}
+
+	void JsonReader::StartStream(std::istream& input, std::ostream& out) {
+		profile::LatencyRecorder latency = profile::LatencyRecorder::FromEnvironment(GetStatRequestTypes());
+		StartStream(input, out, latency);
+		latency.Report();
+	}
+
+	void JsonReader::StartStream(std::istream& input, std::ostream& out, profile::LatencyRecorder& latency) {
+		latency.RestartClock();
+
+		// This thread reads the lines, the workers parse and answer them, the writer puts the answers back in order.
+		// The queues are bounded and the lines are read no further than MAX_STREAM_IN_FLIGHT ahead of the writer,
+		// so a slow stage holds back the reading however long the stream is.
+		using Item = std::pair<size_t, std::string>;
+		parallel::BoundedQueue<Item> lines(STREAM_QUEUE_CAPACITY);
+		parallel::BoundedQueue<Item> answers(STREAM_QUEUE_CAPACITY);
+
+		std::mutex              window_mutex;
+		std::condition_variable window_changed;
+		size_t                  read_count = 0;
+		size_t                  written    = 0;
+		std::exception_ptr      error;
+
+		auto fail = [&](std::exception_ptr current) {
+			{
+				std::lock_guard guard(window_mutex);
+				if (!error) {
+					error = current;
+				}
+			}
+			window_changed.notify_all();
+			lines.Close();
+			answers.Close();
+		};
+
+		auto work = [&] {
+			while (auto item = lines.Pop()) {
+				std::string answer;
+				try {
+					answer = AnswerLine(item->second, latency);
+				} catch (...) {
+					fail(std::current_exception());
+					return;
+				}
+				if (!answers.Push({ item->first, std::move(answer) })) {
+					return;
+				}
+			}
+		};
+
+		auto write = [&] {
+			std::map<size_t, std::string> pending;
+			size_t next = 0;
+			while (auto item = answers.Pop()) {
+				pending.insert(std::move(*item));
+				if (pending.begin()->first != next) {
+					continue;
+				}
+				for (auto it = pending.begin(); it != pending.end() && it->first == next; it = pending.erase(it)) {
+					out << it->second;
+					++next;
+				}
+				bool is_idle;
+				{
+					std::lock_guard guard(window_mutex);
+					written = next;
+					is_idle = written == read_count;
+				}
+				window_changed.notify_all();
+				// Nothing more has been read, the client may be waiting for the answers
+				if (is_idle) {
+					out.flush();
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		const size_t worker_count = parallel::GetThreadCount(MAX_STREAM_IN_FLIGHT);
+		for (size_t i = 0; i < worker_count; ++i) {
+			workers.emplace_back(work);
+		}
+		std::thread writer(write);
+
+		try {
+			std::string line;
+			while (std::getline(input, line)) {
+				if (line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+					continue;
+				}
+				size_t seq;
+				{
+					std::unique_lock lock(window_mutex);
+					window_changed.wait(lock, [&] { return error || read_count - written < MAX_STREAM_IN_FLIGHT; });
+					if (error) {
+						break;
+					}
+					seq = read_count++;
+				}
+				if (!lines.Push({ seq, std::move(line) })) {
+					break;
+				}
+			}
+		} catch (...) {
+			fail(std::current_exception());
+		}
+
+		lines.Close();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		answers.Close();
+		writer.join();
+		out.flush();
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	std::string JsonReader::AnswerLine(const std::string& line, profile::LatencyRecorder& latency) const {
+		// A malformed line is answered and skipped, the stream goes on. The errors of answering a well-formed
+		// request are not the line's, they stop the stream.
+		const json::Node root = ParseLine(line);
+		json::Node node;
+		if (!root.IsDict()) {
+			node = OutBadRequest(std::nullopt);
+		} else {
+			const json::Dict& req = root.AsDict();
+			const std::optional<int> id = HasField(req, "id"sv, &json::Node::IsInt)
+				? std::optional<int>(json::At(req, "id"sv).AsInt())
+				: std::nullopt;
+			const std::optional<StatRequestType> type = HasField(req, "type"sv, &json::Node::IsString)
+				? ParseStatRequestType(json::At(req, "type"sv).AsString())
+				: std::nullopt;
+			node = (id && type && IsWellFormed(*type, req))
+				? AnswerStatRequest(req, latency)
+				: OutBadRequest(id);
 		}
+		std::ostringstream answer;
+		json::PrintCompact(json::Document(std::move(node)), answer);
+		answer.put('\n');
+		return answer.str();
+	}
+
+	void JsonReader::LoadBase(std::istream& input) {
+		const json::Document doc = json::Load(input);
+		const json::Dict& dict   = doc.GetRoot().AsDict();
+
+		ApplySettings(dict);
 		if (dict.count("base_requests"s)) {
 			FillTransportCatalogue(dict);
-			FillGraphInRouter();
+			BuildRouter(false);
+		}
+	}
+
+	void JsonReader::ApplySettings(const json::Dict& dict) {
+		if (dict.count("routing_settings"s)) {
+			const auto [wait, vel] = ReadRoutingSettings(dict.at("routing_settings"s).AsDict());
+			rh_.SetRoutingSettings(wait, vel);
+			const auto [walking_vel, walking_stop_count] = ReadWalkingSettings(dict.at("routing_settings"s).AsDict());
+			rh_.SetWalkingSettings(walking_vel, walking_stop_count);
+			if (const auto budget = ReadRouterMemoryBudget(dict.at("routing_settings"s).AsDict())) {
+				rh_.SetRouterMemoryBudget(*budget);
+			}
 		}
 		if (dict.count("render_settings"s)) {
 			rh_.SetRenderSettings(std::move(ReadRenderingSettings(dict)));
 		}
-		if (dict.count("stat_requests"s)) {
-			AnswerStatRequests(dict, out);
-		}
 	}
 
 	void JsonReader::FillTransportCatalogue(const json::Dict& dict) {
 		const json::Array& base_requests = dict.at("base_requests"s).AsArray();
-		std::vector<std::pair<const std::string&, const json::Dict&>> stops_road_distances;
-
+		std::vector<const json::Dict*> stop_reqs;
+		std::vector<const json::Dict*> bus_reqs;
 		for (const auto& req_node : base_requests) {
 			const json::Dict& req = req_node.AsDict();
-			if (req.at("type"s).AsString() == "Stop"s) {
-				stops_road_distances.emplace_back(req.at("name"s).AsString(), FillStop(req));
-			} 
+			const std::string& type = req.at("type"s).AsString();
+			if (type == "Stop"s) {
+				stop_reqs.push_back(&req);
+			} else if (type == "Bus"s) {
+				bus_reqs.push_back(&req);
+			}
 		}
 
-		for (const auto& [stop_name, dict] : stops_road_distances) {
-			for (const auto& [stop_name_to, distance] : dict) {
-				rh_.SetDistanceBetweenStops(stop_name, stop_name_to, distance.AsInt());
+		// Records are read in parallel and added in the input order, which keeps the stop and bus positions
+		std::vector<Stop> stops(stop_reqs.size());
+		parallel::ForEachIndex(stop_reqs.size(), [this, &stop_reqs, &stops](size_t i) {
+			stops[i] = ReadStop(*stop_reqs[i]);
+		});
+		rh_.AddStops(std::move(stops));
+
+		std::vector<std::vector<RoadDistance>> stops_road_distances(stop_reqs.size());
+		parallel::ForEachIndex(stop_reqs.size(), [this, &stop_reqs, &stops_road_distances](size_t i) {
+			const json::Dict& stop_req = *stop_reqs[i];
+			const StopPtr stop = rh_.SearchStop(stop_req.at("name"s).AsString());
+			for (const auto& [stop_name_to, distance] : stop_req.at("road_distances"s).AsDict()) {
+				stops_road_distances[i].push_back({ stop, rh_.SearchStop(stop_name_to), distance.AsInt() });
 			}
+		});
+		std::vector<RoadDistance> road_distances;
+		for (auto& distances : stops_road_distances) {
+			road_distances.insert(road_distances.end(), distances.begin(), distances.end());
 		}
+		rh_.SetDistancesBetweenStops(road_distances);
 
-		for (const auto& req_node : base_requests) {
-			const json::Dict& req = req_node.AsDict();
-			if (req.at("type"s).AsString() == "Bus"s) {
-				FillBus(req);
-			}
+		std::vector<Bus> buses(bus_reqs.size());
+		parallel::ForEachIndex(bus_reqs.size(), [this, &bus_reqs, &buses](size_t i) {
+			buses[i] = ReadBus(*bus_reqs[i]);
+		});
+		for (Bus& bus : buses) {
+			rh_.AddBus(std::move(bus));
 		}
+
+		rh_.FinalizeCatalogue();
+		rh_.CommitCatalogue();
 	}
 
 	void JsonReader::FillGraphInRouter() {
 		for (const StopPtr stop : rh_.GetStopsInVector()) {
-			std::string_view stop_name(*stop.get()->name.get());
+			std::string_view stop_name(stop.get()->name);
 			rh_.AddStopToRouter(stop_name);
 			rh_.AddWaitEdgeToRouter(stop_name);
 		}
 
-		for (const BusPtr bus : rh_.GetBusesInVector()) {
-			const std::string_view bus_name = *bus->name;
-			for (size_t i = 0; i < bus->route.size() - 1; ++i) {
-				const std::string_view stop_name_from = *bus->route[i]->name;
-
-				int prev_actual = 0;
-				std::string_view prev_stop_name = stop_name_from;
-
-				for (size_t j = i + 1; j < bus->route.size(); ++j) {
-					const std::string_view stop_name_to = *bus->route[j]->name;
-					int actual = *rh_.GetActualDistanceBetweenStops(prev_stop_name, stop_name_to);
-					rh_.AddBusEdgeToRouter(
-						stop_name_from,
-						stop_name_to,
-						bus_name,
-						j - i,
-						prev_actual + actual
-					);
-					prev_stop_name = stop_name_to;
-					prev_actual += actual;
-				}
-			}
-		}
+		rh_.AddBusesToRouter(rh_.GetBusesInVector());
+	}
+
+	profile::Profiler JsonReader::BuildRouter(bool is_profiled) {
+		profile::Profiler profiler = is_profiled ? profile::Profiler::MakeEnabled() : profile::Profiler();
 
+		auto graph_phase = profiler.StartPhase("fill_graph"sv);
+		FillGraphInRouter();
+		graph_phase.Finish();
+
+		auto router_phase = profiler.StartPhase("build_router"sv);
 		rh_.BuildRouter();
+		if (profiler.IsEnabled()) {
+			router_phase.AddCount("vertexes"sv, rh_.GetRouterVertexCount());
+			router_phase.AddCount("edges"sv, rh_.GetRouterEdgeCount());
+		}
+		router_phase.Finish();
+
+		return profiler;
+	}
+
+	void JsonReader::WaitForRouter() const {
+		if (router_build_.valid()) {
+			router_build_.get();
+		}
 	}
 
-	const json::Dict& JsonReader::FillStop(const json::Dict& stop_req) {
+	Stop JsonReader::ReadStop(const json::Dict& stop_req) const {
 		const auto& node_latitude = stop_req.at("latitude"s);
 		double latitude = node_latitude.IsPureDouble() ? node_latitude.AsDouble() : node_latitude.AsInt();
 		const auto& node_longitude = stop_req.at("longitude"s);
 		double longitude = node_longitude.IsPureDouble() ? node_longitude.AsDouble() : node_longitude.AsInt();
-		Stop stop(std::move(std::string(stop_req.at("name"s).AsString())), latitude, longitude);
-		rh_.AddStop(std::move(stop));
 
-		return stop_req.at("road_distances"s).AsDict();
+		return Stop(stop_req.at("name"s).AsString(), latitude, longitude);
 	}
 
-	void JsonReader::FillBus(const json::Dict& bus_req) {
+	Bus JsonReader::ReadBus(const json::Dict& bus_req) const {
 		auto [route, unique_stops_num, last_stop] = WordsToRoute(bus_req.at("stops"s).AsArray(), bus_req.at("is_roundtrip"s).AsBool());
 		const auto [geographic, actual] = rh_.ComputeRouteLengths(route);
 		if (last_stop.get() == rh_.SearchStop(route.front()).get()) {
-			Bus bus(std::move(std::string(bus_req.at("name"s).AsString())), rh_.StopsToStopPtr(std::move(route)), unique_stops_num, actual, geographic);
-			rh_.AddBus(std::move(bus));
-		} else {
-			Bus bus(std::move(std::string(bus_req.at("name"s).AsString())), rh_.StopsToStopPtr(std::move(route)), unique_stops_num, actual, geographic, last_stop);
-			rh_.AddBus(std::move(bus));
+			return Bus(bus_req.at("name"s).AsString(), rh_.StopsToStopPtr(std::move(route)), unique_stops_num, actual, geographic);
 		}
+
+		return Bus(bus_req.at("name"s).AsString(), rh_.StopsToStopPtr(std::move(route)), unique_stops_num, actual, geographic, last_stop);
 	}
 
 	std::tuple<json_reader::JsonReader::BusWaitTime, json_reader::JsonReader::BusVelocity> JsonReader::ReadRoutingSettings(const json::Dict& dict) {
@@ -127,6 +485,35 @@ namespace json_reader {
 		return { wait_time, velocity };
 	}
 
+	std::tuple<json_reader::JsonReader::WalkingVelocity, json_reader::JsonReader::WalkingStopCount> JsonReader::ReadWalkingSettings(const json::Dict& dict) {
+		const double velocity = dict.count("walking_velocity"s) ? GetDoubleFromNode(dict.at("walking_velocity"s)) : transport::Router::DEFAULT_WALKING_VELOCITY;
+		const int stop_count  = dict.count("walking_stop_count"s) ? dict.at("walking_stop_count"s).AsInt() : static_cast<int>(transport::Router::DEFAULT_WALKING_STOP_COUNT);
+
+		// The walking times would be infinite or negative at a non-positive velocity, the default is taken instead
+		return { velocity > 0. ? velocity : transport::Router::DEFAULT_WALKING_VELOCITY, std::max(stop_count, 0) };
+	}
+
+	std::optional<size_t> JsonReader::ReadRouterMemoryBudget(const json::Dict& dict) const {
+		if (!dict.count("router_memory_budget_mb"s)) {
+			return std::nullopt;
+		}
+		const double megabytes = std::max(GetDoubleFromNode(dict.at("router_memory_budget_mb"s)), 0.);
+
+		return static_cast<size_t>(megabytes * 1024. * 1024.);
+	}
+
+	transport::RoutePoint JsonReader::ReadRoutePoint(const json::Node& node) const {
+		if (node.IsString()) {
+			return std::string_view(node.AsString());
+		}
+		const json::Dict& dict = node.AsDict();
+
+		return geo::Coordinates{
+			GetDoubleFromNode(json::At(dict, "latitude"sv)),
+			GetDoubleFromNode(json::At(dict, "longitude"sv))
+		};
+	}
+
 	renderer::RenderingSettings JsonReader::ReadRenderingSettings(const json::Dict& dict) {
 		renderer::RenderingSettings settings;
 
@@ -213,38 +600,90 @@ namespace json_reader {
 		return {};
 	}
 
-	void JsonReader::AnswerStatRequests(const json::Dict& dict, std::ostream& out) const {
+	void JsonReader::AnswerStatRequests(const json::Dict& dict, std::ostream& out, profile::LatencyRecorder& latency) const {
+		latency.RestartClock();
+
 		json::Array result;
-		const json::Array& stat_requests = dict.at("stat_requests"s).AsArray();
-		for (const auto& req_node : stat_requests) {
-			const json::Dict& req = req_node.AsDict();
-			const std::string& type = req.at("type"s).AsString();
+		const json::Array& stat_requests = json::At(dict, "stat_requests"sv).AsArray();
+		result.reserve(stat_requests.size());
+		std::optional<std::vector<std::optional<json::Node>>> route_batch;
+		// The first answer of every key by the type, repeated requests copy it with their own id
+		std::vector<std::unordered_map<std::string_view, json::Node>> answers(STAT_REQUEST_TYPE_COUNT);
+		for (size_t i = 0; i < stat_requests.size(); ++i) {
+			const json::Dict& req = stat_requests[i].AsDict();
+			const std::optional<StatRequestType> parsed_type = ParseStatRequestType(json::At(req, "type"sv).AsString());
+			// Requests of an unknown type are answered as Map and are not timed
+			const StatRequestType type = parsed_type.value_or(StatRequestType::MAP);
+			// The build of the router is not charged to the request that waits for it
+			if (IsRouterRequest(type)) {
+				WaitForRouter();
+			}
+			if (type == StatRequestType::ROUTE && !route_batch) {
+				route_batch = OutRouteBatch(stat_requests, latency);
+			}
+			// The batch has recorded the latencies of the routes it answers
+			const bool is_batched = type == StatRequestType::ROUTE && (*route_batch)[i];
+			auto timer = latency.StartTimer(parsed_type && !is_batched ? static_cast<size_t>(type) : STAT_REQUEST_TYPE_COUNT);
+			const int id = json::At(req, "id"sv).AsInt();
+
+			auto& type_answers = answers[static_cast<size_t>(type)];
+			const std::optional<std::string_view> key = GetAnswerKey(type, req);
+			const auto answer_it = key ? type_answers.find(*key) : type_answers.end();
 			json::Node node;
-			if (type == "Stop"s) {
-				node = OutStopStat(
-					rh_.GetStopStat(req.at("name"s).AsString()), 
-					req.at("id"s).AsInt()
-				);
-			} else if (type == "Bus"s) {
-				node = OutBusStat(
-					rh_.GetBusStat(req.at("name"s).AsString()), 
-					req.at("id"s).AsInt()
-				);
-			} else if (type == "Route"s) {
-				node = OutRouteReq(
-					req.at("from"s).AsString(),
-					req.at("to"s).AsString(),
-					req.at("id"s).AsInt()
-				);
+			if (answer_it != type_answers.end()) {
+				node = WithRequestId(answer_it->second, id);
 			} else {
-				node = OutMapReq(req.at("id"s).AsInt());
+				if (is_batched) {
+					node = std::move(*(*route_batch)[i]);
+				} else {
+					node = OutStatReq(type, req, id);
+				}
+				if (key) {
+					type_answers.emplace(*key, node);
+				}
 			}
+			timer.Stop();
 			result.push_back(std::move(node));
 		}
 
 		json::Print(json::Document(json::Node(result)), out);
 	}
 
+	json::Node JsonReader::AnswerStatRequest(const json::Dict& req, profile::LatencyRecorder& latency) const {
+		const std::optional<StatRequestType> parsed_type = ParseStatRequestType(json::At(req, "type"sv).AsString());
+		const StatRequestType type = parsed_type.value_or(StatRequestType::MAP);
+		if (IsRouterRequest(type)) {
+			WaitForRouter();
+		}
+		auto timer = latency.StartTimer(parsed_type ? static_cast<size_t>(type) : STAT_REQUEST_TYPE_COUNT);
+
+		return OutStatReq(type, req, json::At(req, "id"sv).AsInt());
+	}
+
+	json::Node JsonReader::OutStatReq(StatRequestType type, const json::Dict& req, int id) const {
+		switch (type) {
+		case StatRequestType::STOP:
+			return OutStopStat(rh_.GetStopStat(json::At(req, "name"sv).AsString()), id);
+		case StatRequestType::BUS:
+			return OutBusStat(rh_.GetBusStat(json::At(req, "name"sv).AsString()), id);
+		case StatRequestType::ROUTE:
+			return OutRouteReq(ReadRoutePoint(json::At(req, "from"sv)), ReadRoutePoint(json::At(req, "to"sv)), id);
+		case StatRequestType::ROUTE_MATRIX:
+			return OutRouteMatrixReq(json::At(req, "from"sv).AsArray(), json::At(req, "to"sv).AsArray(), id);
+		case StatRequestType::REACHABLE:
+			return OutReachableReq(json::At(req, "from"sv).AsString(), GetDoubleFromNode(json::At(req, "max_time"sv)), id);
+		case StatRequestType::NEAREST_STOPS:
+			return OutNearestStopsReq(req, id);
+		case StatRequestType::STOPS_IN_BOX:
+			return OutStopsInBoxReq(req, id);
+		case StatRequestType::STATS:
+			return OutStatsReq(id);
+		case StatRequestType::MAP:
+			break;
+		}
+		return OutMapReq(id);
+	}
+
 	json::Node JsonReader::OutStopStat(const std::optional<StopStat> stop_stat, int id) const {
 		if (stop_stat.has_value()) {
 			json::Array arr;
@@ -263,13 +702,13 @@ namespace json_reader {
 				[](const BusPtr& lhs, const BusPtr& rhs) {
 					return 
 						std::lexicographical_compare(
-							lhs.get()->name.get()->begin(), lhs.get()->name.get()->end(),
-							rhs.get()->name.get()->begin(), rhs.get()->name.get()->end()
+							lhs.get()->name.begin(), lhs.get()->name.end(),
+							rhs.get()->name.begin(), rhs.get()->name.end()
 						);
 				}
 			);
 			for (const BusPtr& bus : std::move(tmp)) {
-				arr.push_back(json::Node(*bus.get()->name.get()));
+				arr.push_back(json::Node(std::string(bus.get()->name)));
 			}
 			json::Dict dict = {
 				{ "buses"s,      json::Node(std::move(arr)) },
@@ -308,8 +747,72 @@ namespace json_reader {
 		}
 	}
 
-	json::Node JsonReader::OutRouteReq(const std::string_view from, const std::string_view to, int id) const {
-		const auto route_info = rh_.GetRouteInfo(from, to);
+	json::Node JsonReader::OutRouteReq(const transport::RoutePoint& from, const transport::RoutePoint& to, int id) const {
+		return OutRouteInfo(rh_.GetRouteInfo(from, to), id);
+	}
+
+	std::vector<std::optional<json::Node>> JsonReader::OutRouteBatch(const json::Array& stat_requests, profile::LatencyRecorder& latency) const {
+		// Routes between two stops are grouped by the origin, the destinations of an origin share its search
+		std::unordered_map<std::string_view, std::vector<size_t>> origin_to_requests;
+		std::vector<std::string_view> origins;
+		for (size_t i = 0; i < stat_requests.size(); ++i) {
+			const json::Dict& req = stat_requests[i].AsDict();
+			if (ParseStatRequestType(json::At(req, "type"sv).AsString()) != StatRequestType::ROUTE || !json::At(req, "from"sv).IsString() || !json::At(req, "to"sv).IsString()) {
+				continue;
+			}
+			const auto [it, is_new] = origin_to_requests.try_emplace(json::At(req, "from"sv).AsString());
+			if (is_new) {
+				origins.push_back(it->first);
+			}
+			it->second.push_back(i);
+		}
+
+		std::vector<std::optional<json::Node>> result(stat_requests.size());
+		parallel::ForEachIndex(origins.size(), [this, &stat_requests, &origin_to_requests, &origins, &result, &latency](size_t i) {
+			const auto start = profile::LatencyRecorder::Clock::now();
+			const std::vector<size_t>& requests = origin_to_requests.at(origins[i]);
+			// Repeated destinations are routed once, destination_indexes[j] is the position of the j-th request's one
+			std::vector<std::string_view> destinations;
+			std::vector<size_t> destination_indexes;
+			std::unordered_map<std::string_view, size_t> destination_to_index;
+			destination_indexes.reserve(requests.size());
+			for (const size_t request : requests) {
+				const std::string_view destination = json::At(stat_requests[request].AsDict(), "to"sv).AsString();
+				const auto [it, is_new] = destination_to_index.try_emplace(destination, destinations.size());
+				if (is_new) {
+					destinations.push_back(destination);
+				}
+				destination_indexes.push_back(it->second);
+			}
+			const auto route_infos = rh_.GetRouteInfos(origins[i], destinations);
+
+			// The first request of a destination gets the answer, the repeated ones copy it with their own id
+			std::vector<const json::Node*> answers(destinations.size(), nullptr);
+			for (size_t j = 0; j < requests.size(); ++j) {
+				const size_t destination_index = destination_indexes[j];
+				const int id = json::At(stat_requests[requests[j]].AsDict(), "id"sv).AsInt();
+				std::optional<json::Node>& node = result[requests[j]];
+				if (answers[destination_index]) {
+					node = WithRequestId(*answers[destination_index], id);
+				} else {
+					node = OutRouteInfo(route_infos[destination_index], id);
+					answers[destination_index] = &*node;
+				}
+			}
+
+			// The requests of an origin share its search, each is charged an equal part of it
+			if (latency.IsEnabled()) {
+				const auto share = (profile::LatencyRecorder::Clock::now() - start) / requests.size();
+				for (size_t j = 0; j < requests.size(); ++j) {
+					latency.Record(static_cast<size_t>(StatRequestType::ROUTE), share);
+				}
+			}
+		});
+
+		return result;
+	}
+
+	json::Node JsonReader::OutRouteInfo(const std::optional<transport::RouteInfo>& route_info, int id) const {
 		if (route_info) {
 			json::Array arr;
 			arr.reserve(route_info->items.size());
@@ -322,6 +825,16 @@ namespace json_reader {
 						{ "time"s,      json::Node(item.wait_item->time) }
 					};
 					arr.push_back(std::move(dict));
+				} else if (item.walk_item) {
+					json::Dict dict = {
+						{ "type"s,     json::Node(std::move("Walk"s))       },
+						{ "distance"s, json::Node(item.walk_item->distance) },
+						{ "time"s,     json::Node(item.walk_item->time)     }
+					};
+					if (item.walk_item->stop_name) {
+						dict["stop_name"s] = json::Node(std::string(*item.walk_item->stop_name));
+					}
+					arr.push_back(std::move(dict));
 				} else {
 					std::string bus_name(item.bus_item->bus_name);
 					json::Dict dict = {
@@ -364,6 +877,147 @@ namespace json_reader {
 		return json::Node(std::move(dict));
 	}
 
+	json::Node JsonReader::OutBadRequest(std::optional<int> id) const {
+		json::Dict dict = {
+			{ "error_message"s, json::Node(std::move("bad request"s)) }
+		};
+		if (id) {
+			dict["request_id"s] = json::Node(*id);
+		}
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutStatsReq(int id) const {
+		const memory::Report report = rh_.GetMemoryReport();
+		json::Dict memory_kb;
+		for (const memory::Item& item : report) {
+			memory_kb[item.name] = json::Node(static_cast<int>(profile::ToKb(item.bytes)));
+		}
+
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id)                                                       },
+			{ "memory_kb"s,  json::Node(std::move(memory_kb))                                     },
+			{ "total_kb"s,   json::Node(static_cast<int>(profile::ToKb(memory::GetTotal(report)))) }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutRouteMatrixReq(const json::Array& from, const json::Array& to, int id) const {
+		auto to_names = [](const json::Array& arr) {
+			std::vector<std::string_view> names;
+			names.reserve(arr.size());
+			for (const auto& node : arr) {
+				names.push_back(node.AsString());
+			}
+			return names;
+		};
+		const transport::TimeMatrix total_times = rh_.GetTotalTimes(to_names(from), to_names(to));
+
+		json::Array rows;
+		rows.reserve(total_times.size());
+		for (const auto& times : total_times) {
+			json::Array row;
+			row.reserve(times.size());
+			for (const auto& time : times) {
+				row.push_back(time ? json::Node(*time) : json::Node(nullptr));
+			}
+			rows.push_back(json::Node(std::move(row)));
+		}
+
+		json::Dict dict = {
+			{ "request_id"s,  json::Node(id)              },
+			{ "total_times"s, json::Node(std::move(rows)) }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutReachableReq(const std::string_view from, double max_time, int id) const {
+		const auto reachable_stops = rh_.GetReachableStops(from, max_time);
+		if (reachable_stops) {
+			json::Array arr;
+			arr.reserve(reachable_stops->size());
+			for (const auto& stop : *reachable_stops) {
+				json::Dict dict = {
+					{ "stop_name"s, json::Node(std::string(stop.stop_name)) },
+					{ "time"s,      json::Node(stop.time)                   }
+				};
+				arr.push_back(std::move(dict));
+			}
+
+			json::Dict dict = {
+				{ "request_id"s, json::Node(id)             },
+				{ "stops"s,      json::Node(std::move(arr)) }
+			};
+
+			return json::Node(std::move(dict));
+		} else {
+			json::Dict dict = {
+				{ "request_id"s,    json::Node(id)                      },
+				{ "error_message"s, json::Node(std::move("not found"s)) }
+			};
+
+			return json::Node(std::move(dict));
+		}
+	}
+
+	json::Node JsonReader::OutNearestStopsReq(const json::Dict& req, int id) const {
+		const geo::Coordinates point{
+			GetDoubleFromNode(json::At(req, "latitude"sv)),
+			GetDoubleFromNode(json::At(req, "longitude"sv))
+		};
+		const int count = json::At(req, "count"sv).AsInt();
+
+		json::Array arr;
+		for (const auto& [stop, distance] : rh_.GetNearestStops(point, std::max(count, 0))) {
+			json::Dict dict = {
+				{ "stop_name"s, json::Node(std::string(stop->name)) },
+				{ "distance"s,  json::Node(distance)                }
+			};
+			arr.push_back(std::move(dict));
+		}
+
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id)             },
+			{ "stops"s,      json::Node(std::move(arr)) }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutStopsInBoxReq(const json::Dict& req, int id) const {
+		const geo::Coordinates min{
+			GetDoubleFromNode(json::At(req, "min_latitude"sv)),
+			GetDoubleFromNode(json::At(req, "min_longitude"sv))
+		};
+		const geo::Coordinates max{
+			GetDoubleFromNode(json::At(req, "max_latitude"sv)),
+			GetDoubleFromNode(json::At(req, "max_longitude"sv))
+		};
+
+		std::vector<StopPtr> stops = rh_.GetStopsInBox(min, max);
+		std::sort(stops.begin(), stops.end(),
+			[](const StopPtr& lhs, const StopPtr& rhs) {
+				return lhs->name < rhs->name;
+			}
+		);
+
+		json::Array arr;
+		arr.reserve(stops.size());
+		for (const StopPtr& stop : stops) {
+			arr.push_back(json::Node(std::string(stop->name)));
+		}
+
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id)             },
+			{ "stops"s,      json::Node(std::move(arr)) }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
 	std::tuple<std::vector<std::string_view>, int, StopPtr> JsonReader::WordsToRoute(const json::Array& words, bool is_roundtrip) const {
 		std::vector<std::string_view> result;
 		std::unordered_set<std::string_view, std::hash<std::string_view>> stops_unique_names;
@@ -371,7 +1025,7 @@ namespace json_reader {
 
 		for (size_t i = 0; i < words.size(); ++i) {
 			StopPtr stop = rh_.SearchStop(words[i].AsString());
-			result.push_back(*stop.get()->name.get());
+			result.push_back(stop.get()->name);
 			stops_unique_names.insert(words[i].AsString());
 		}
 		const StopPtr last_stop = rh_.SearchStop(result.back());
@@ -380,7 +1034,7 @@ namespace json_reader {
 			result.reserve(words.size() * 2);
 			for (int i = (int)words.size() - 2; i >= 0; --i) {
 				StopPtr stop = rh_.SearchStop(words[i].AsString());
-				result.push_back(*stop.get()->name.get());
+				result.push_back(stop.get()->name);
 			}
 		}
 
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "json.h"
+#include "latency_recorder.h"
+#include "profiler.h"
 #include "transport_catalogue.h"
 #include "request_handler.h"
 
+#include <future>
 #include <iostream>
 #include <tuple>
 #include <string_view>
@@ -13,35 +16,94 @@
 
 namespace json_reader {
 
+	// The types of the stat requests as the latencies are recorded
+	std::vector<std::string> GetStatRequestTypes();
+
+	// In the order of GetStatRequestTypes
+	enum class StatRequestType {
+		STOP,
+		BUS,
+		ROUTE,
+		ROUTE_MATRIX,
+		REACHABLE,
+		NEAREST_STOPS,
+		STOPS_IN_BOX,
+		STATS,
+		MAP,
+	};
+
 	class JsonReader final {
 	private:
-		using BusWaitTime = int;
-		using BusVelocity = double;
+		using BusWaitTime      = int;
+		using BusVelocity      = double;
+		using WalkingVelocity  = double;
+		using WalkingStopCount = size_t;
 
 	public:
+		// Bounds of the memory StartStream holds: the lines queued for the workers and the answers queued for
+		// the writer, and the lines read ahead of the last answer written
+		static constexpr size_t STREAM_QUEUE_CAPACITY = 256;
+		static constexpr size_t MAX_STREAM_IN_FLIGHT  = 1024;
+
 		JsonReader(request_handler::RequestHandler& req_handler);
 
+		// Profiles and records the latencies as configured by the environment
 		void Start(std::istream& input, std::ostream& out);
+		void Start(std::istream& input, std::ostream& out, profile::Profiler& profiler, profile::LatencyRecorder& latency);
+		// Reads the settings and the base requests and builds the router, the stat requests are left
+		// to StartStream or to a reader of another format
+		void LoadBase(std::istream& input);
+		// Answers the stat requests one per line as they arrive, each answer is a line in the order of the requests.
+		// The lines are answered on a pool of threads, and the answers are flushed whenever all the lines read
+		// so far are answered. A malformed line gets a "bad request" error: not a dict, no int id, an unknown type
+		// or a field of the type missing. An unknown stop or bus is "not found".
+		void StartStream(std::istream& input, std::ostream& out);
+		void StartStream(std::istream& input, std::ostream& out, profile::LatencyRecorder& latency);
 
 	private:
 		request_handler::RequestHandler& rh_;
+		// The router is built on another thread while the requests not needing it are answered,
+		// the future holds the phases of the build
+		std::shared_future<profile::Profiler> router_build_;
 
+		void                ApplySettings(const json::Dict& dict);
 		void                FillTransportCatalogue(const json::Dict& dict);
 		void                FillGraphInRouter();
-		const json::Dict&   FillStop(const json::Dict& stop_req);
-		void                FillBus(const json::Dict& bus_req);
+		profile::Profiler   BuildRouter(bool is_profiled);
+		// Rethrows the error of the build if there was one
+		void                WaitForRouter() const;
+		domain::Stop        ReadStop(const json::Dict& stop_req) const;
+		domain::Bus         ReadBus(const json::Dict& bus_req)   const;
 
-		std::tuple<BusWaitTime, BusVelocity> ReadRoutingSettings(const json::Dict& dict);
-		renderer::RenderingSettings          ReadRenderingSettings(const json::Dict& dict);
-		double                               GetDoubleFromNode(const json::Node& node)  const;
-		std::vector<svg::Color>              GetColorsFromArray(const json::Array& arr) const;
-		svg::Color                           GetColor(const json::Node& node)           const;
+		std::tuple<BusWaitTime, BusVelocity>          ReadRoutingSettings(const json::Dict& dict);
+		std::tuple<WalkingVelocity, WalkingStopCount> ReadWalkingSettings(const json::Dict& dict);
+		// In bytes, from "router_memory_budget_mb"
+		std::optional<size_t>                         ReadRouterMemoryBudget(const json::Dict& dict) const;
+		transport::RoutePoint                         ReadRoutePoint(const json::Node& node)     const;
+		renderer::RenderingSettings                   ReadRenderingSettings(const json::Dict& dict);
+		double                                        GetDoubleFromNode(const json::Node& node)  const;
+		std::vector<svg::Color>                       GetColorsFromArray(const json::Array& arr) const;
+		svg::Color                                    GetColor(const json::Node& node)           const;
 
-		void       AnswerStatRequests(const json::Dict& dict, std::ostream& out)               const;
+		void       AnswerStatRequests(const json::Dict& dict, std::ostream& out, profile::LatencyRecorder& latency) const;
+		json::Node AnswerStatRequest(const json::Dict& req, profile::LatencyRecorder& latency)                   const;
+		// The answer to a line of the stream with the line break
+		std::string AnswerLine(const std::string& line, profile::LatencyRecorder& latency)                       const;
+		json::Node OutStatReq(StatRequestType type, const json::Dict& req, int id)                                const;
+		json::Node OutBadRequest(std::optional<int> id)                                                           const;
 		json::Node OutStopStat(const std::optional<domain::StopStat> stop_stat, int id)        const;
 		json::Node OutBusStat(const std::optional<domain::BusStat> bus_stat, int id)           const;
-		json::Node OutRouteReq(const std::string_view from, const std::string_view to, int id) const;
-		json::Node OutMapReq(int id)                                                           const;
+		json::Node OutRouteReq(const transport::RoutePoint& from, const transport::RoutePoint& to, int id) const;
+		// The answers of the Route requests between two stops at their positions, empty at the other positions.
+		// Records the latency of every answered request as its share of the search from its origin.
+		std::vector<std::optional<json::Node>> OutRouteBatch(const json::Array& stat_requests, profile::LatencyRecorder& latency) const;
+		json::Node OutRouteInfo(const std::optional<transport::RouteInfo>& route_info, int id)            const;
+		json::Node OutMapReq(int id)                                                                       const;
+		json::Node OutRouteMatrixReq(const json::Array& from, const json::Array& to, int id)   const;
+		json::Node OutReachableReq(const std::string_view from, double max_time, int id)      const;
+		json::Node OutNearestStopsReq(const json::Dict& req, int id)                           const;
+		json::Node OutStopsInBoxReq(const json::Dict& req, int id)                             const;
+		json::Node OutStatsReq(int id)                                                         const;
 
 
 		std::tuple<std::vector<std::string_view>, int, domain::StopPtr> WordsToRoute(const json::Array& words, bool is_roundtrip) const;
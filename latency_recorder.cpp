@@ -0,0 +1,273 @@
+#include "latency_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace profile {
+
+	using namespace std::literals;
+
+	namespace {
+
+		size_t GetMostSignificantBit(std::uint64_t value) {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index;
+#else
+			return 63 - __builtin_clzll(value);
+#endif
+		}
+
+		// Single writer: a plain load and store is enough and cheaper than an atomic increment
+		void AddRelaxed(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		double ToSeconds(std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double>(duration).count();
+		}
+	}
+
+	void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+		const std::uint64_t value_ns = std::min<std::uint64_t>(std::max<std::int64_t>(latency.count(), 0), MAX_VALUE_NS);
+		AddRelaxed(counts_[GetBucketIndex(value_ns)], 1);
+		AddRelaxed(count_, 1);
+		AddRelaxed(sum_ns_, value_ns);
+	}
+
+	void LatencyHistogram::Merge(const LatencyHistogram& other) {
+		for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+			AddRelaxed(counts_[i], other.counts_[i].load(std::memory_order_relaxed));
+		}
+		AddRelaxed(count_, other.count_.load(std::memory_order_relaxed));
+		AddRelaxed(sum_ns_, other.sum_ns_.load(std::memory_order_relaxed));
+	}
+
+	std::uint64_t LatencyHistogram::GetCount() const {
+		return count_.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds LatencyHistogram::GetSum() const {
+		return std::chrono::nanoseconds(sum_ns_.load(std::memory_order_relaxed));
+	}
+
+	std::chrono::nanoseconds LatencyHistogram::GetValueAtQuantile(double quantile) const {
+		// The total is summed from the buckets, the count may be ahead of them while a thread records
+		std::uint64_t total = 0;
+		for (const auto& count : counts_) {
+			total += count.load(std::memory_order_relaxed);
+		}
+		if (total == 0) {
+			return 0ns;
+		}
+		const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(quantile * total)));
+		std::uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+			seen += counts_[i].load(std::memory_order_relaxed);
+			if (seen >= rank) {
+				return std::chrono::nanoseconds(GetBucketMiddle(i));
+			}
+		}
+		return std::chrono::nanoseconds(MAX_VALUE_NS);
+	}
+
+	size_t LatencyHistogram::GetBucketIndex(std::uint64_t value_ns) {
+		if (value_ns < SUB_BUCKET_COUNT) {
+			return static_cast<size_t>(value_ns);
+		}
+		// The top SUB_BUCKET_BITS bits of the value select the sub-bucket in [SUB_BUCKET_COUNT / 2, SUB_BUCKET_COUNT)
+		const size_t shift = GetMostSignificantBit(value_ns) - (SUB_BUCKET_BITS - 1);
+		return shift * SUB_BUCKET_COUNT / 2 + static_cast<size_t>(value_ns >> shift);
+	}
+
+	std::uint64_t LatencyHistogram::GetBucketMiddle(size_t index) {
+		if (index < SUB_BUCKET_COUNT) {
+			return index;
+		}
+		const size_t shift      = index / (SUB_BUCKET_COUNT / 2) - 1;
+		const size_t sub_bucket = index - shift * SUB_BUCKET_COUNT / 2;
+		return (std::uint64_t(sub_bucket) << shift) + (std::uint64_t(1) << shift) / 2;
+	}
+
+	LatencyRecorder::Timer::Timer(LatencyRecorder* recorder, size_t type)
+		: recorder_(recorder)
+		, type_(type)
+	{
+		if (recorder_ != nullptr) {
+			start_ = Clock::now();
+		}
+	}
+
+	LatencyRecorder::Timer::~Timer() {
+		Stop();
+	}
+
+	void LatencyRecorder::Timer::Stop() {
+		if (recorder_ == nullptr) {
+			return;
+		}
+		recorder_->Record(type_, Clock::now() - start_);
+		recorder_ = nullptr;
+	}
+
+	LatencyRecorder::LatencyRecorder(std::vector<std::string> type_names, bool is_enabled, bool is_reported, std::optional<std::string> report_path)
+		: id_([] {
+			static std::atomic<std::uint64_t> next_id{ 0 };
+			return next_id.fetch_add(1, std::memory_order_relaxed);
+		}())
+		, type_names_(std::move(type_names))
+		, is_enabled_(is_enabled)
+		, is_reported_(is_reported)
+		, report_path_(std::move(report_path))
+		, start_(Clock::now())
+	{}
+
+	LatencyRecorder LatencyRecorder::FromEnvironment(std::vector<std::string> type_names) {
+		const char* value = std::getenv(LATENCY_ENV);
+		if (value == nullptr || *value == '\0' || value == "0"sv) {
+			return LatencyRecorder(std::move(type_names), false, false, std::nullopt);
+		}
+		if (value == "1"sv || value == "stderr"sv) {
+			return LatencyRecorder(std::move(type_names), true, true, std::nullopt);
+		}
+		return LatencyRecorder(std::move(type_names), true, true, std::string(value));
+	}
+
+	LatencyRecorder LatencyRecorder::MakeEnabled(std::vector<std::string> type_names) {
+		return LatencyRecorder(std::move(type_names), true, false, std::nullopt);
+	}
+
+	bool LatencyRecorder::IsEnabled() const {
+		return is_enabled_;
+	}
+
+	LatencyRecorder::Timer LatencyRecorder::StartTimer(std::string_view type_name) {
+		if (!is_enabled_) {
+			return Timer(nullptr, 0);
+		}
+		const auto it = std::find(type_names_.begin(), type_names_.end(), type_name);
+		if (it == type_names_.end()) {
+			return Timer(nullptr, 0);
+		}
+		return Timer(this, static_cast<size_t>(it - type_names_.begin()));
+	}
+
+	LatencyRecorder::Timer LatencyRecorder::StartTimer(size_t type) {
+		if (!is_enabled_ || type >= type_names_.size()) {
+			return Timer(nullptr, 0);
+		}
+		return Timer(this, type);
+	}
+
+	void LatencyRecorder::Record(size_t type, std::chrono::nanoseconds latency) {
+		GetThreadHistograms()[type].Record(latency);
+	}
+
+	LatencyRecorder::Histograms& LatencyRecorder::GetThreadHistograms() {
+		// The last recorder the thread used, ids are never reused, so a destroyed recorder is never matched
+		thread_local std::pair<std::uint64_t, Histograms*> last_histograms{ 0, nullptr };
+		if (last_histograms.second && last_histograms.first == id_) {
+			return *last_histograms.second;
+		}
+
+		const std::thread::id thread_id = std::this_thread::get_id();
+		std::lock_guard lock(threads_mutex_);
+		auto it = std::find_if(thread_histograms_.begin(), thread_histograms_.end(), [thread_id](const auto& entry) {
+			return entry.first == thread_id;
+		});
+		if (it == thread_histograms_.end()) {
+			thread_histograms_.emplace_back(thread_id, std::make_unique<Histograms>(type_names_.size()));
+			it = std::prev(thread_histograms_.end());
+		}
+		last_histograms = { id_, it->second.get() };
+
+		return *last_histograms.second;
+	}
+
+	void LatencyRecorder::RestartClock() {
+		start_ = Clock::now();
+	}
+
+	std::vector<LatencySummary> LatencyRecorder::GetSummaries() const {
+		Histograms merged(type_names_.size());
+		{
+			std::lock_guard lock(threads_mutex_);
+			for (const auto& [thread_id, histograms] : thread_histograms_) {
+				for (size_t type = 0; type < type_names_.size(); ++type) {
+					merged[type].Merge((*histograms)[type]);
+				}
+			}
+		}
+
+		std::vector<LatencySummary> summaries;
+		summaries.reserve(type_names_.size());
+		for (size_t type = 0; type < type_names_.size(); ++type) {
+			const LatencyHistogram& histogram = merged[type];
+			summaries.push_back({
+				type_names_[type],
+				histogram.GetCount(),
+				histogram.GetSum(),
+				histogram.GetValueAtQuantile(0.5),
+				histogram.GetValueAtQuantile(0.99),
+				histogram.GetValueAtQuantile(0.999)
+			});
+		}
+
+		return summaries;
+	}
+
+	std::chrono::nanoseconds LatencyRecorder::GetElapsed() const {
+		return Clock::now() - start_;
+	}
+
+	void LatencyRecorder::Report() const {
+		if (!is_reported_) {
+			return;
+		}
+		if (!report_path_) {
+			PrintText(std::cerr);
+			return;
+		}
+		std::ofstream out(*report_path_);
+		if (!out) {
+			std::cerr << "Can't write the latency metrics to "s << *report_path_ << std::endl;
+			return;
+		}
+		PrintText(out);
+	}
+
+	void LatencyRecorder::PrintText(std::ostream& out) const {
+		const std::vector<LatencySummary> summaries = GetSummaries();
+		const double elapsed = ToSeconds(GetElapsed());
+
+		out << "# HELP transport_request_latency_seconds Latency of the stat requests by type.\n"s;
+		out << "# TYPE transport_request_latency_seconds summary\n"s;
+		for (const LatencySummary& summary : summaries) {
+			const std::string labels = "type=\""s + summary.type + '"';
+			out << "transport_request_latency_seconds{"s << labels << ",quantile=\"0.5\"} "s   << ToSeconds(summary.p50)  << '\n';
+			out << "transport_request_latency_seconds{"s << labels << ",quantile=\"0.99\"} "s  << ToSeconds(summary.p99)  << '\n';
+			out << "transport_request_latency_seconds{"s << labels << ",quantile=\"0.999\"} "s << ToSeconds(summary.p999) << '\n';
+			out << "transport_request_latency_seconds_sum{"s << labels << "} "s << ToSeconds(summary.sum) << '\n';
+			out << "transport_request_latency_seconds_count{"s << labels << "} "s << summary.count << '\n';
+		}
+
+		out << "# HELP transport_requests_per_second Stat requests answered per second of the answering stage.\n"s;
+		out << "# TYPE transport_requests_per_second gauge\n"s;
+		std::uint64_t total_count = 0;
+		for (const LatencySummary& summary : summaries) {
+			out << "transport_requests_per_second{type=\""s << summary.type << "\"} "s
+				<< (elapsed > 0. ? summary.count / elapsed : 0.) << '\n';
+			total_count += summary.count;
+		}
+		out << "transport_requests_per_second "s << (elapsed > 0. ? total_count / elapsed : 0.) << std::endl;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace profile {
+
+	// The environment variable that turns the latency recording on: "1" or "stderr" prints the metrics to stderr,
+	// any other value is the path of the metrics file
+	constexpr const char* LATENCY_ENV = "TRANSPORT_LATENCY";
+
+	// Log-linear buckets in the HdrHistogram layout: 32 buckets per power of two of nanoseconds,
+	// so a reported value is within 1/32 of the recorded one. Values above MAX_VALUE_NS are clamped.
+	// Only one thread may record, any thread may read meanwhile.
+	class LatencyHistogram {
+	public:
+		static constexpr size_t        SUB_BUCKET_BITS  = 6;
+		static constexpr size_t        SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+		static constexpr size_t        MAX_VALUE_BITS   = 40;
+		static constexpr std::uint64_t MAX_VALUE_NS     = (std::uint64_t(1) << MAX_VALUE_BITS) - 1;
+		static constexpr size_t        BUCKET_COUNT     = (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT / 2 + SUB_BUCKET_COUNT;
+
+		void Record(std::chrono::nanoseconds latency);
+		void Merge(const LatencyHistogram& other);
+
+		std::uint64_t            GetCount() const;
+		std::chrono::nanoseconds GetSum()   const;
+		// The middle of the bucket holding the value of the rank ceil(quantile * count), 0 if empty
+		std::chrono::nanoseconds GetValueAtQuantile(double quantile) const;
+
+	private:
+		std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> counts_{};
+		std::atomic<std::uint64_t>                           count_{ 0 };
+		std::atomic<std::uint64_t>                           sum_ns_{ 0 };
+
+		static size_t        GetBucketIndex(std::uint64_t value_ns);
+		static std::uint64_t GetBucketMiddle(size_t index);
+	};
+
+	struct LatencySummary {
+		std::string              type;
+		std::uint64_t            count = 0;
+		std::chrono::nanoseconds sum{};
+		std::chrono::nanoseconds p50{};
+		std::chrono::nanoseconds p99{};
+		std::chrono::nanoseconds p999{};
+	};
+
+	// Latency histograms and counters of the request types. Every thread records into its own histograms,
+	// which are merged only by the export, so the recording threads never share a cache line.
+	class LatencyRecorder {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		class Timer {
+		public:
+			Timer(const Timer&) = delete;
+			Timer& operator=(const Timer&) = delete;
+			~Timer();
+
+			void Stop();
+
+		private:
+			friend class LatencyRecorder;
+
+			Timer(LatencyRecorder* recorder, size_t type);
+
+			LatencyRecorder*  recorder_ = nullptr;
+			size_t            type_     = 0;
+			Clock::time_point start_;
+		};
+
+		LatencyRecorder(const LatencyRecorder&) = delete;
+		LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+		static LatencyRecorder FromEnvironment(std::vector<std::string> type_names);
+		// Records regardless of the environment and reports nothing, for the callers reading the summaries
+		static LatencyRecorder MakeEnabled(std::vector<std::string> type_names);
+
+		bool IsEnabled() const;
+		// A disabled recorder and an unknown type give a timer that does not read the clock
+		Timer StartTimer(std::string_view type_name);
+		// By the position of the type name, saves the search for the callers that know it
+		Timer StartTimer(size_t type);
+		void  Record(size_t type, std::chrono::nanoseconds latency);
+
+		// The requests per second are counted from the creation or from the last restart, which must not
+		// race with the recording
+		void RestartClock();
+
+		// Of all the threads, in the order of the type names
+		std::vector<LatencySummary> GetSummaries() const;
+		std::chrono::nanoseconds    GetElapsed()   const;
+
+		// Writes the metrics where the environment asked for, does nothing unless created from the environment
+		void Report() const;
+		// Prometheus text exposition format: quantiles, sums and counts of the latencies in seconds,
+		// and the requests per second since the clock was started
+		void PrintText(std::ostream& out) const;
+
+	private:
+		using Histograms = std::vector<LatencyHistogram>;
+
+		LatencyRecorder(std::vector<std::string> type_names, bool is_enabled, bool is_reported, std::optional<std::string> report_path);
+
+		const std::uint64_t               id_;
+		const std::vector<std::string>    type_names_;
+		const bool                        is_enabled_;
+		const bool                        is_reported_;
+		const std::optional<std::string>  report_path_;
+		Clock::time_point                 start_;
+
+		mutable std::mutex                                                   threads_mutex_;
+		// A thread id may be reused once its thread is gone, the new thread then goes on with the same histograms
+		std::vector<std::pair<std::thread::id, std::unique_ptr<Histograms>>> thread_histograms_;
+
+		Histograms& GetThreadHistograms();
+	};
+}
@@ -1,17 +1,65 @@
-﻿#include "json_reader.h"
+﻿#include "benchmark.h"
+#include "binary_reader.h"
+#include "json_reader.h"
 #include "map_renderer.h"
 #include "svg.h"
 #include "request_handler.h"
 
 #include <iostream>
 #include <fstream>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 using namespace std::literals;
 
-int main() {
+int main(int argc, char* argv[]) {
+	// "binary <base.json>" and "ndjson <base.json>": the settings and the base requests come from the file,
+	// the stat requests are binary frames or JSON lines on the standard input
+	const bool is_binary = argc == 3 && argv[1] == "binary"sv;
+	const bool is_stream = argc == 3 && argv[1] == "ndjson"sv;
+	if (argc > 1 && !is_binary && !is_stream) {
+		return bench::RunCommand(std::vector<std::string_view>(argv + 1, argv + argc), std::cout, std::cerr);
+	}
+
 	renderer::MapRenderer mr;
 	transport::TransportCatalogue db;
 	request_handler::RequestHandler rh(db, mr);
 	json_reader::JsonReader js_reader(rh);
-	js_reader.Start(std::cin, std::cout);
+	if (!is_binary && !is_stream) {
+		js_reader.Start(std::cin, std::cout);
+		return 0;
+	}
+
+	std::ifstream base(argv[2]);
+	if (!base) {
+		std::cerr << "Can't read "s << argv[2] << std::endl;
+		return 1;
+	}
+	js_reader.LoadBase(base);
+
+#if defined(_WIN32)
+	if (is_binary) {
+		_setmode(_fileno(stdin), _O_BINARY);
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+	// Buffered and untied, so the requests are read in blocks and the answers are flushed by the reader
+	std::ios::sync_with_stdio(false);
+	std::cin.tie(nullptr);
+	if (is_stream) {
+		js_reader.StartStream(std::cin, std::cout);
+		return 0;
+	}
+	binary_reader::BinaryReader bin_reader(rh);
+	try {
+		bin_reader.Start(std::cin, std::cout);
+	} catch (const binary_reader::ProtocolError& error) {
+		std::cerr << error.what() << std::endl;
+		return 1;
+	}
 }
@@ -29,8 +29,8 @@ namespace renderer {
 			buses.end(),
 			[](const BusPtr& lhs, const BusPtr& rhs) {
 				return std::lexicographical_compare(
-					lhs.get()->name.get()->begin(), lhs.get()->name.get()->end(),
-					rhs.get()->name.get()->begin(), rhs.get()->name.get()->end()
+					lhs.get()->name.begin(), lhs.get()->name.end(),
+					rhs.get()->name.begin(), rhs.get()->name.end()
 				);
 			}
 		);
@@ -39,8 +39,8 @@ namespace renderer {
 			stops.end(),
 			[](const std::pair<StopPtr, StopStat>& lhs, const std::pair<StopPtr, StopStat>& rhs) {
 				return std::lexicographical_compare(
-					lhs.first.get()->name.get()->begin(), lhs.first.get()->name.get()->end(),
-					rhs.first.get()->name.get()->begin(), rhs.first.get()->name.get()->end()
+					lhs.first.get()->name.begin(), lhs.first.get()->name.end(),
+					rhs.first.get()->name.begin(), rhs.first.get()->name.end()
 				);
 			}
 		);
@@ -96,7 +96,7 @@ namespace renderer {
 				.SetFontSize(settings_.bus_label_font_size)
 				.SetFontFamily("Verdana"s)
 				.SetFontWeight("bold"s)
-				.SetData(*bus.name.get());
+				.SetData(std::string(bus.name));
 
 			svg::Text text_substrate = text;
 			text_substrate
@@ -166,7 +166,7 @@ namespace renderer {
 				.SetOffset(settings_.stop_label_offset)
 				.SetFontSize(settings_.stop_label_font_size)
 				.SetFontFamily("Verdana"s)
-				.SetData(*stop.name.get());
+				.SetData(std::string(stop.name));
 
 			svg::Text text_substrate = text;
 			text_substrate
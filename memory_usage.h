@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+	// Approximate heap footprint of a component by structure, in bytes.
+	// Capacities are counted, the allocator's own overhead is not.
+	struct Item {
+		std::string name;
+		size_t      bytes = 0;
+	};
+	using Report = std::vector<Item>;
+
+	inline size_t GetTotal(const Report& report) {
+		size_t total = 0;
+		for (const Item& item : report) {
+			total += item.bytes;
+		}
+		return total;
+	}
+
+	// The items of part with the prefix added to their names
+	inline void Append(Report& report, const std::string& prefix, const Report& part) {
+		for (const Item& item : part) {
+			report.push_back({ prefix + item.name, item.bytes });
+		}
+	}
+
+	template<typename T>
+	size_t GetVectorBytes(const std::vector<T>& vector) {
+		return vector.capacity() * sizeof(T);
+	}
+
+	inline size_t GetVectorBytes(const std::vector<bool>& vector) {
+		return vector.capacity() / 8;
+	}
+
+	// The bucket array and one node per element holding the value, the next pointer and the cached hash
+	template<typename NodeContainer>
+	size_t GetNodeContainerBytes(const NodeContainer& container) {
+		return container.bucket_count() * sizeof(void*)
+			+ container.size() * (sizeof(typename NodeContainer::value_type) + sizeof(void*) + sizeof(size_t));
+	}
+}
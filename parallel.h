@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+	inline size_t GetThreadCount(size_t task_count) {
+		const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		return std::max<size_t>(std::min(hardware, task_count), 1);
+	}
+
+	// Calls func(i) for every i in [0, count), indexes are handed out to the threads one by one.
+	// The first exception thrown by func stops handing out indexes and is rethrown once the threads are joined.
+	template<typename Func>
+	void ForEachIndex(size_t count, Func func) {
+		const size_t thread_count = GetThreadCount(count);
+		if (thread_count == 1) {
+			for (size_t i = 0; i < count; ++i) {
+				func(i);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next_index{ 0 };
+		std::exception_ptr  error;
+		std::mutex          error_mutex;
+		auto worker = [&next_index, &func, &error, &error_mutex, count] {
+			try {
+				for (size_t i = next_index++; i < count; i = next_index++) {
+					func(i);
+				}
+			} catch (...) {
+				next_index = count;
+				std::lock_guard guard(error_mutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(thread_count - 1);
+		for (size_t i = 1; i < thread_count; ++i) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Blocks the producers while it is full and the consumers while it is empty, so a fast stage can't run
+	// ahead of a slow one. Once closed, Push refuses the items and Pop returns the remaining ones, then nothing.
+	template<typename T>
+	class BoundedQueue {
+	public:
+		explicit BoundedQueue(size_t capacity)
+			: capacity_(std::max<size_t>(capacity, 1))
+		{}
+
+		bool Push(T item) {
+			std::unique_lock lock(mutex_);
+			not_full_.wait(lock, [this] { return is_closed_ || items_.size() < capacity_; });
+			if (is_closed_) {
+				return false;
+			}
+			items_.push_back(std::move(item));
+			lock.unlock();
+			not_empty_.notify_one();
+			return true;
+		}
+
+		std::optional<T> Pop() {
+			std::unique_lock lock(mutex_);
+			not_empty_.wait(lock, [this] { return is_closed_ || !items_.empty(); });
+			if (items_.empty()) {
+				return std::nullopt;
+			}
+			T item = std::move(items_.front());
+			items_.pop_front();
+			lock.unlock();
+			not_full_.notify_one();
+			return item;
+		}
+
+		void Close() {
+			{
+				std::lock_guard guard(mutex_);
+				is_closed_ = true;
+			}
+			not_full_.notify_all();
+			not_empty_.notify_all();
+		}
+
+	private:
+		const size_t            capacity_;
+		std::mutex              mutex_;
+		std::condition_variable not_full_;
+		std::condition_variable not_empty_;
+		std::deque<T>           items_;
+		bool                    is_closed_ = false;
+	};
+
+	// A shared pointer that writers replace while any thread reads it, readers take no locks.
+	// A reader announces itself in the counter of the current epoch for as long as it copies the pointer,
+	// Store switches the epoch and frees the replaced copy once the readers of the old epoch are gone.
+	// Writers are serialized by a mutex and wait for those readers, which hold the epoch for a copy only.
+	template<typename T>
+	class PublishedPtr {
+	public:
+		explicit PublishedPtr(std::shared_ptr<T> value = nullptr)
+			: current_(new std::shared_ptr<T>(std::move(value)))
+		{}
+
+		PublishedPtr(const PublishedPtr&) = delete;
+		PublishedPtr& operator=(const PublishedPtr&) = delete;
+
+		~PublishedPtr() {
+			delete current_.load();
+		}
+
+		std::shared_ptr<T> Load() const {
+			size_t epoch = epoch_.load();
+			while (true) {
+				readers_[epoch % 2].count.fetch_add(1);
+				// A Store between the two loads may be waiting for the other counter already
+				const size_t current_epoch = epoch_.load();
+				if (current_epoch == epoch) {
+					break;
+				}
+				readers_[epoch % 2].count.fetch_sub(1);
+				epoch = current_epoch;
+			}
+			std::shared_ptr<T> result = *current_.load();
+			readers_[epoch % 2].count.fetch_sub(1);
+			return result;
+		}
+
+		void Store(std::shared_ptr<T> value) {
+			std::lock_guard guard(writer_mutex_);
+			const std::unique_ptr<std::shared_ptr<T>> prev(current_.exchange(new std::shared_ptr<T>(std::move(value))));
+			// Readers that came after the switch see the new pointer
+			const size_t epoch = epoch_.fetch_add(1);
+			while (readers_[epoch % 2].count.load() != 0) {
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		static_assert(std::atomic<size_t>::is_always_lock_free && std::atomic<std::shared_ptr<T>*>::is_always_lock_free,
+			"Readers should take no locks");
+
+		// On their own cache lines, the readers of all the threads write to them
+		struct alignas(64) ReaderCount {
+			std::atomic<size_t> count{ 0 };
+		};
+
+		std::atomic<std::shared_ptr<T>*> current_;
+		std::atomic<size_t>              epoch_{ 0 };
+		mutable ReaderCount              readers_[2];
+		std::mutex                       writer_mutex_;
+	};
+}
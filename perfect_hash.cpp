@@ -0,0 +1,229 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace containers {
+
+	namespace {
+		// Buckets hold this many keys on average: fewer buckets take less memory and longer to build
+		constexpr size_t        BUCKET_SIZE = 4;
+		constexpr std::uint32_t MAX_PILOT   = 1u << 24;
+		constexpr int           MAX_SEEDS   = 16;
+
+		std::uint64_t Mix(std::uint64_t hash) {
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		// MurmurHash64A, reads the input as little endian words
+		std::uint64_t HashString(std::string_view str, std::uint64_t seed) {
+			constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+			constexpr int           r = 47;
+
+			std::uint64_t hash = seed ^ (str.size() * m);
+			size_t i = 0;
+			for (; i + 8 <= str.size(); i += 8) {
+				std::uint64_t word = 0;
+				for (size_t j = 0; j < 8; ++j) {
+					word |= static_cast<std::uint64_t>(static_cast<unsigned char>(str[i + j])) << (8 * j);
+				}
+				word *= m;
+				word ^= word >> r;
+				word *= m;
+				hash ^= word;
+				hash *= m;
+			}
+			if (i < str.size()) {
+				for (size_t j = 0; i + j < str.size(); ++j) {
+					hash ^= static_cast<std::uint64_t>(static_cast<unsigned char>(str[i + j])) << (8 * j);
+				}
+				hash *= m;
+			}
+			hash ^= hash >> r;
+			hash *= m;
+			hash ^= hash >> r;
+
+			return hash;
+		}
+
+		// Little endian, size bytes of the value
+		void WriteInteger(std::ostream& out, std::uint64_t value, size_t size) {
+			unsigned char bytes[8];
+			for (size_t i = 0; i < size; ++i) {
+				bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+			}
+			out.write(reinterpret_cast<const char*>(bytes), size);
+		}
+
+		std::uint64_t ReadInteger(std::istream& in, size_t size) {
+			unsigned char bytes[8];
+			if (!in.read(reinterpret_cast<char*>(bytes), size)) {
+				throw std::runtime_error("Truncated perfect hash");
+			}
+			std::uint64_t value = 0;
+			for (size_t i = 0; i < size; ++i) {
+				value |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+			}
+			return value;
+		}
+
+		void WriteArray(std::ostream& out, const std::vector<std::uint32_t>& values) {
+			for (const std::uint32_t value : values) {
+				WriteInteger(out, value, 4);
+			}
+		}
+
+		// Grows as the values are read, so a corrupted size fails on the end of the stream rather than on allocation
+		std::vector<std::uint32_t> ReadArray(std::istream& in, size_t size) {
+			std::vector<std::uint32_t> values;
+			values.reserve(std::min<size_t>(size, 1 << 16));
+			for (size_t i = 0; i < size; ++i) {
+				values.push_back(static_cast<std::uint32_t>(ReadInteger(in, 4)));
+			}
+			return values;
+		}
+
+		size_t GetBucketCount(size_t key_count) {
+			return key_count == 0 ? 0 : key_count / BUCKET_SIZE + 1;
+		}
+	}
+
+	MinimalPerfectHash::MinimalPerfectHash(const std::vector<std::string_view>& keys) {
+		if (keys.empty()) {
+			return;
+		}
+		{
+			std::vector<std::string_view> sorted_keys(keys);
+			std::sort(sorted_keys.begin(), sorted_keys.end());
+			if (std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) != sorted_keys.end()) {
+				throw std::invalid_argument("Keys of a perfect hash should be unique");
+			}
+		}
+
+		std::vector<std::uint64_t> hashes(keys.size());
+		for (int attempt = 0; attempt < MAX_SEEDS; ++attempt) {
+			seed_ = Mix(attempt + 1);
+			for (size_t i = 0; i < keys.size(); ++i) {
+				hashes[i] = HashString(keys[i], seed_);
+			}
+			if (TryBuild(hashes)) {
+				return;
+			}
+		}
+		throw std::runtime_error("Failed to build a perfect hash");
+	}
+
+	size_t MinimalPerfectHash::GetSize() const {
+		return slot_to_id_.size();
+	}
+
+	size_t MinimalPerfectHash::GetMemoryUsage() const {
+		return sizeof(*this) + (pilots_.capacity() + slot_to_id_.capacity()) * sizeof(std::uint32_t);
+	}
+
+	size_t MinimalPerfectHash::Find(std::string_view key) const {
+		const std::uint64_t hash = HashString(key, seed_);
+		return slot_to_id_[GetSlot(hash, pilots_[GetBucket(hash)])];
+	}
+
+	void MinimalPerfectHash::Serialize(std::ostream& out) const {
+		WriteInteger(out, seed_, 8);
+		WriteInteger(out, slot_to_id_.size(), 4);
+		WriteArray(out, pilots_);
+		WriteArray(out, slot_to_id_);
+	}
+
+	MinimalPerfectHash MinimalPerfectHash::Deserialize(std::istream& in) {
+		MinimalPerfectHash result;
+		result.seed_ = ReadInteger(in, 8);
+		const size_t key_count = static_cast<size_t>(ReadInteger(in, 4));
+		result.pilots_     = ReadArray(in, GetBucketCount(key_count));
+		result.slot_to_id_ = ReadArray(in, key_count);
+
+		// Find must stay within the table: the pilots are as built and the slots hold every id once
+		const bool are_pilots_valid = std::all_of(result.pilots_.begin(), result.pilots_.end(), [](std::uint32_t pilot) {
+			return pilot < MAX_PILOT;
+		});
+		if (!are_pilots_valid) {
+			throw std::runtime_error("Corrupted perfect hash");
+		}
+		std::vector<bool> is_id_found(key_count, false);
+		for (const std::uint32_t id : result.slot_to_id_) {
+			if (id >= key_count || is_id_found[id]) {
+				throw std::runtime_error("Corrupted perfect hash");
+			}
+			is_id_found[id] = true;
+		}
+
+		return result;
+	}
+
+	size_t MinimalPerfectHash::GetBucket(std::uint64_t hash) const {
+		// The high half picks the bucket, so that it is independent of the slot
+		return static_cast<size_t>(((hash >> 32) * pilots_.size()) >> 32);
+	}
+
+	size_t MinimalPerfectHash::GetSlot(std::uint64_t hash, std::uint32_t pilot) const {
+		// Mixed after the pilot is applied: a plain xor leaves the low bits of two hashes equally apart
+		return static_cast<size_t>(Mix(hash ^ (pilot * 0x9e3779b97f4a7c15ULL)) % slot_to_id_.size());
+	}
+
+	bool MinimalPerfectHash::TryBuild(const std::vector<std::uint64_t>& hashes) {
+		const size_t size = hashes.size();
+		pilots_.assign(GetBucketCount(size), 0);
+		slot_to_id_.assign(size, 0);
+
+		std::vector<std::vector<std::uint32_t>> buckets(pilots_.size());
+		for (size_t id = 0; id < size; ++id) {
+			buckets[GetBucket(hashes[id])].push_back(static_cast<std::uint32_t>(id));
+		}
+		// Big buckets are placed first, while most of the slots are free
+		std::vector<size_t> order(buckets.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+			return buckets[lhs].size() > buckets[rhs].size();
+		});
+
+		std::vector<bool>   is_taken(size, false);
+		std::vector<size_t> slots;
+		for (const size_t bucket : order) {
+			const auto& ids = buckets[bucket];
+			if (ids.empty()) {
+				break;
+			}
+			std::uint32_t pilot = 0;
+			for (; pilot < MAX_PILOT; ++pilot) {
+				slots.clear();
+				bool is_free = true;
+				for (const std::uint32_t id : ids) {
+					const size_t slot = GetSlot(hashes[id], pilot);
+					if (is_taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+						is_free = false;
+						break;
+					}
+					slots.push_back(slot);
+				}
+				if (is_free) {
+					break;
+				}
+			}
+			if (pilot == MAX_PILOT) {
+				return false;
+			}
+			pilots_[bucket] = pilot;
+			for (size_t i = 0; i < ids.size(); ++i) {
+				is_taken[slots[i]]     = true;
+				slot_to_id_[slots[i]] = ids[i];
+			}
+		}
+
+		return true;
+	}
+}
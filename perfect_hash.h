@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace containers {
+
+	// Minimal perfect hash over a fixed set of strings in the hash-and-displace scheme:
+	// a key's bucket stores a pilot that moves every key of the bucket to a slot of its own.
+	// The hash is platform independent, so a serialised table stays valid across builds.
+	class MinimalPerfectHash {
+	public:
+		MinimalPerfectHash() = default;
+		// Keys must be unique, the id of a key is its position
+		explicit MinimalPerfectHash(const std::vector<std::string_view>& keys);
+
+		size_t GetSize()       const;
+		size_t GetMemoryUsage() const;
+
+		// The id of the key if it is one of the keys, an arbitrary id otherwise: the caller compares the key once.
+		// Must not be called on an empty table.
+		size_t Find(std::string_view key) const;
+
+		// The seed, the key count, the pilots and the slots, little endian in 8, 4 and 4 bytes per value.
+		// Deserialize throws std::runtime_error on a truncated or corrupted table.
+		void                      Serialize(std::ostream& out) const;
+		static MinimalPerfectHash Deserialize(std::istream& in);
+
+	private:
+		std::uint64_t              seed_ = 0;
+		std::vector<std::uint32_t> pilots_;
+		std::vector<std::uint32_t> slot_to_id_;
+
+		size_t GetBucket(std::uint64_t hash)                       const;
+		size_t GetSlot(std::uint64_t hash, std::uint32_t pilot)   const;
+		bool   TryBuild(const std::vector<std::uint64_t>& hashes);
+	};
+}
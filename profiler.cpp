@@ -0,0 +1,211 @@
+#include "profiler.h"
+#include "json.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace profile {
+
+	using namespace std::literals;
+
+	size_t GetPeakRssKb() {
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return 0;
+		}
+		return counters.PeakWorkingSetSize / 1024;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) {
+			return 0;
+		}
+#if defined(__APPLE__)
+		return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+		return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+	}
+
+	size_t GetPhysicalMemoryKb() {
+#if defined(_WIN32)
+		MEMORYSTATUSEX status;
+		status.dwLength = sizeof(status);
+		if (!GlobalMemoryStatusEx(&status)) {
+			return 0;
+		}
+		return static_cast<size_t>(status.ullTotalPhys / 1024);
+#else
+		const long pages     = sysconf(_SC_PHYS_PAGES);
+		const long page_size = sysconf(_SC_PAGE_SIZE);
+		if (pages <= 0 || page_size <= 0) {
+			return 0;
+		}
+		return static_cast<size_t>(pages) / 1024 * static_cast<size_t>(page_size);
+#endif
+	}
+
+	size_t ToKb(size_t bytes) {
+		return (bytes + 1023) / 1024;
+	}
+
+	Profiler::Phase::Phase(Profiler* profiler, std::string_view name)
+		: profiler_(profiler)
+	{
+		if (profiler_ == nullptr) {
+			return;
+		}
+		record_.name       = std::string(name);
+		start_peak_rss_kb_ = GetPeakRssKb();
+		start_             = Clock::now();
+	}
+
+	Profiler::Phase::~Phase() {
+		Finish();
+	}
+
+	void Profiler::Phase::AddCount(std::string_view name, size_t count) {
+		if (profiler_ != nullptr) {
+			record_.counts.emplace_back(std::string(name), count);
+		}
+	}
+
+	void Profiler::Phase::Finish() {
+		if (profiler_ == nullptr) {
+			return;
+		}
+		record_.time_ms           = std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+		record_.peak_rss_delta_kb = GetPeakRssKb() - start_peak_rss_kb_;
+		profiler_->phases_.push_back(std::move(record_));
+		profiler_ = nullptr;
+	}
+
+	Profiler Profiler::FromEnvironment() {
+		Profiler profiler;
+		const char* value = std::getenv(PROFILE_ENV);
+		if (value == nullptr || *value == '\0' || value == "0"sv) {
+			return profiler;
+		}
+		profiler.is_enabled_  = true;
+		profiler.is_reported_ = true;
+		if (value != "1"sv && value != "stderr"sv) {
+			profiler.report_path_ = value;
+		}
+
+		return profiler;
+	}
+
+	Profiler Profiler::MakeEnabled() {
+		Profiler profiler;
+		profiler.is_enabled_ = true;
+		return profiler;
+	}
+
+	bool Profiler::IsEnabled() const {
+		return is_enabled_;
+	}
+
+	Profiler::Phase Profiler::StartPhase(std::string_view name) {
+		return Phase(is_enabled_ ? this : nullptr, name);
+	}
+
+	const std::vector<PhaseRecord>& Profiler::GetPhases() const {
+		return phases_;
+	}
+
+	void Profiler::AddPhases(const std::vector<PhaseRecord>& phases) {
+		phases_.insert(phases_.end(), phases.begin(), phases.end());
+	}
+
+	void Profiler::SetMemoryReport(memory::Report report) {
+		memory_report_ = std::move(report);
+	}
+
+	void Profiler::Report() const {
+		if (!is_reported_) {
+			return;
+		}
+		if (!report_path_) {
+			PrintText(std::cerr);
+			return;
+		}
+		std::ofstream out(*report_path_);
+		if (!out) {
+			std::cerr << "Can't write the profile to "s << *report_path_ << std::endl;
+			return;
+		}
+		PrintJson(out);
+	}
+
+	void Profiler::PrintText(std::ostream& out) const {
+		double total_ms = 0.;
+		out << std::left << std::setw(20) << "phase"s << std::right << std::setw(12) << "time, ms"s << std::setw(16) << "peak RSS +KiB"s << "  counts"s << '\n';
+		for (const PhaseRecord& phase : phases_) {
+			out << std::left << std::setw(20) << phase.name
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(3) << phase.time_ms
+				<< std::setw(16) << phase.peak_rss_delta_kb << ' ';
+			for (const auto& [name, count] : phase.counts) {
+				out << ' ' << name << '=' << count;
+			}
+			out << '\n';
+			total_ms += phase.time_ms;
+		}
+		out << std::left << std::setw(20) << "total"s << std::right << std::setw(12) << total_ms
+			<< std::setw(16) << GetPeakRssKb() << "  (peak RSS, KiB)"s << std::endl;
+
+		if (memory_report_.empty()) {
+			return;
+		}
+		out << '\n' << std::left << std::setw(40) << "structure"s << std::right << std::setw(12) << "KiB"s << '\n';
+		for (const memory::Item& item : memory_report_) {
+			out << std::left << std::setw(40) << item.name << std::right << std::setw(12) << ToKb(item.bytes) << '\n';
+		}
+		out << std::left << std::setw(40) << "total"s << std::right << std::setw(12) << ToKb(memory::GetTotal(memory_report_)) << std::endl;
+	}
+
+	void Profiler::PrintJson(std::ostream& out) const {
+		json::Array phases;
+		double total_ms = 0.;
+		for (const PhaseRecord& phase : phases_) {
+			json::Dict counts;
+			for (const auto& [name, count] : phase.counts) {
+				counts[name] = json::Node(static_cast<int>(count));
+			}
+			json::Dict dict = {
+				{ "name"s,              json::Node(phase.name)                                },
+				{ "time_ms"s,           json::Node(phase.time_ms)                             },
+				{ "peak_rss_delta_kb"s, json::Node(static_cast<int>(phase.peak_rss_delta_kb)) },
+				{ "counts"s,            json::Node(std::move(counts))                         }
+			};
+			phases.emplace_back(std::move(dict));
+			total_ms += phase.time_ms;
+		}
+		json::Dict memory_kb;
+		for (const memory::Item& item : memory_report_) {
+			memory_kb[item.name] = json::Node(static_cast<int>(ToKb(item.bytes)));
+		}
+		json::Dict dict = {
+			{ "phases"s,      json::Node(std::move(phases))                    },
+			{ "total_ms"s,    json::Node(total_ms)                             },
+			{ "peak_rss_kb"s, json::Node(static_cast<int>(GetPeakRssKb()))     },
+			{ "memory_kb"s,   json::Node(std::move(memory_kb))                 }
+		};
+		json::Print(json::Document(json::Node(std::move(dict))), out);
+		out << std::endl;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace profile {
+
+	// The environment variable that turns the profiling on: "1" or "stderr" prints a table to stderr,
+	// any other value is the path of a JSON report
+	constexpr const char* PROFILE_ENV = "TRANSPORT_PROFILE";
+
+	struct PhaseRecord {
+		std::string                                  name;
+		double                                       time_ms           = 0.;
+		size_t                                       peak_rss_delta_kb = 0;
+		std::vector<std::pair<std::string, size_t>> counts;
+	};
+
+	// Peak resident set size of the process in KiB, 0 where it is unknown
+	size_t GetPeakRssKb();
+	// Physical memory of the machine in KiB, 0 where it is unknown
+	size_t GetPhysicalMemoryKb();
+	// Rounded up
+	size_t ToKb(size_t bytes);
+
+	// Wall time, peak RSS growth and item counts of the startup phases.
+	// A disabled profiler does not read the clock or the RSS at all.
+	class Profiler {
+	public:
+		class Phase {
+		public:
+			Phase(const Phase&) = delete;
+			Phase& operator=(const Phase&) = delete;
+			~Phase();
+
+			void AddCount(std::string_view name, size_t count);
+			void Finish();
+
+		private:
+			friend class Profiler;
+
+			using Clock = std::chrono::steady_clock;
+
+			Phase(Profiler* profiler, std::string_view name);
+
+			Profiler*         profiler_ = nullptr;
+			PhaseRecord       record_;
+			Clock::time_point start_;
+			size_t            start_peak_rss_kb_ = 0;
+		};
+
+		Profiler() = default;
+		static Profiler FromEnvironment();
+		// Records regardless of the environment and reports nothing, for the callers reading the phases
+		static Profiler MakeEnabled();
+
+		bool  IsEnabled() const;
+		Phase StartPhase(std::string_view name);
+
+		const std::vector<PhaseRecord>& GetPhases() const;
+		// Appends the phases recorded by a profiler on another thread
+		void                            AddPhases(const std::vector<PhaseRecord>& phases);
+		// The footprint of the built structures, reported after the phases
+		void                            SetMemoryReport(memory::Report report);
+		// Writes the phases where the environment asked for, does nothing unless created from the environment
+		void Report() const;
+		void PrintText(std::ostream& out) const;
+		void PrintJson(std::ostream& out) const;
+
+	private:
+		bool                       is_enabled_  = false;
+		bool                       is_reported_ = false;
+		std::optional<std::string> report_path_;
+		std::vector<PhaseRecord>   phases_;
+		memory::Report             memory_report_;
+	};
+}
@@ -1,4 +1,5 @@
 #include "request_handler.h"
+#include "parallel.h"
 
 #include <unordered_set>
 #include <vector>
@@ -7,11 +8,14 @@
 
 namespace request_handler {
 	using namespace domain;
+	using namespace std::literals;
 
 	RequestHandler::RequestHandler(transport::TransportCatalogue& db, renderer::MapRenderer& mr)
 		: db_(db)
 		, mr_(mr)
-	{}
+	{
+		Publish();
+	}
 
 	void RequestHandler::AddBus(const std::string_view raw_query) {
 		auto [words, separator] = SplitIntoWordsBySeparator(raw_query);
@@ -47,6 +51,10 @@ namespace request_handler {
 		db_.AddStop(std::move(stop));
 	}
 
+	void RequestHandler::AddStops(std::vector<Stop>&& stops) {
+		db_.AddStops(std::move(stops));
+	}
+
 	void RequestHandler::SetDistanceBetweenStops(const std::string_view raw_query) {
 		auto [parts, _] = SplitIntoWordsBySeparator(raw_query);
 		const auto& stop_X = parts[0];
@@ -62,6 +70,10 @@ namespace request_handler {
 		db_.SetDistanceBetweenStops(first, second, distance);
 	}
 
+	void RequestHandler::SetDistancesBetweenStops(const std::vector<RoadDistance>& distances) {
+		db_.SetDistancesBetweenStops(distances);
+	}
+
 	BusPtr RequestHandler::SearchBus(const std::string_view name) const {
 		return db_.SearchBus(name);
 	}
@@ -78,37 +90,34 @@ namespace request_handler {
 		return db_.GetStopsInVector();
 	}
 
-	std::optional<BusStat> RequestHandler::GetBusStat(const std::string_view bus_name) const {
-		BusPtr bus = db_.SearchBus(bus_name);
-		if (bus == nullptr) {
-			return {};
-		}
+	size_t RequestHandler::GetBusCount() const {
+		return GetPublished()->catalogue->GetBusCount();
+	}
 
-		return std::optional<BusStat>({
-			bus_name,
-			static_cast<int>(bus.get()->route.size()),
-			bus->unique_stops,
-			bus->route_actual_length,
-			bus->route_actual_length / bus->route_geographic_length
-		});
+	size_t RequestHandler::GetStopCount() const {
+		return GetPublished()->catalogue->GetStopCount();
+	}
+
+	std::optional<BusStat> RequestHandler::GetBusStat(const std::string_view bus_name) const {
+		return GetPublished()->catalogue->GetBusStat(bus_name);
 	}
 
 	std::optional<StopStat> RequestHandler::GetStopStat(const std::string_view stop_name) const {
-		StopPtr stop = db_.SearchStop(stop_name);
-		if (stop == nullptr) {
-			return {};
-		}
+		return GetStopStat(GetPublished()->catalogue, stop_name);
+	}
 
-		return std::optional<StopStat>({
-			stop_name,
-			GetBusesByStop(stop_name)
-		});
+	std::vector<std::pair<StopPtr, double>> RequestHandler::GetNearestStops(geo::Coordinates point, size_t count) const {
+		return GetPublished()->catalogue->GetNearestStops(point, count);
+	}
+
+	std::vector<StopPtr> RequestHandler::GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+		return GetPublished()->catalogue->GetStopsInBox(min, max);
 	}
 
-	const std::unordered_set<BusPtr>* RequestHandler::GetBusesByStop(const std::string_view stop_name) const {
-		StopPtr stop = db_.SearchStop(stop_name);
+	std::shared_ptr<const std::unordered_set<BusPtr>> RequestHandler::GetBusesByStop(const std::string_view stop_name) const {
+		const auto stop_stat = GetStopStat(stop_name);
 
-		return db_.GetPassingBusesByStop(stop);
+		return stop_stat ? stop_stat->passing_buses : nullptr;
 	}
 
 	std::tuple<double, int> RequestHandler::ComputeRouteLengths(const std::vector<std::string_view>& route) const {
@@ -146,11 +155,12 @@ namespace request_handler {
 	}
 
 	svg::Document RequestHandler::RenderMap() const {
-		std::vector<BusPtr> buses = db_.GetBusesInVector();
+		const auto snapshot = GetPublished()->catalogue;
+		std::vector<BusPtr> buses = snapshot->GetBusesInVector();
 
 		std::vector<std::pair<StopPtr, StopStat>> stops;
-		for (StopPtr stop : db_.GetStopsInVector()) {
-			stops.emplace_back(std::pair<StopPtr, StopStat>{ stop, *GetStopStat(*stop.get()->name.get()) });
+		for (StopPtr stop : snapshot->GetStopsInVector()) {
+			stops.emplace_back(std::pair<StopPtr, StopStat>{ stop, *GetStopStat(snapshot, stop.get()->name) });
 		}
 
 		return mr_.MakeDocument(std::move(buses), std::move(stops));
@@ -164,8 +174,21 @@ namespace request_handler {
 		rt_.SetSettings(bus_wait_time, bus_velocity);
 	}
 
+	void RequestHandler::SetWalkingSettings(const double walking_velocity, const size_t walking_stop_count) {
+		rt_.SetWalkingSettings(walking_velocity, walking_stop_count);
+	}
+
+	void RequestHandler::SetRouterMemoryBudget(const size_t memory_budget) {
+		rt_.SetMemoryBudget(memory_budget);
+	}
+
+	void RequestHandler::SetRouterExpectedQueryCount(const size_t query_count) {
+		rt_.SetExpectedQueryCount(query_count);
+	}
+
 	void RequestHandler::AddStopToRouter(const std::string_view name) {
-		rt_.AddStop(name);
+		const StopPtr stop = db_.SearchStop(name);
+		rt_.AddStop(name, { stop->latitude, stop->longitude });
 	}
 
 	void RequestHandler::AddWaitEdgeToRouter(const std::string_view stop_name) {
@@ -176,13 +199,120 @@ namespace request_handler {
 		rt_.AddBusEdge(stop_from, stop_to, bus_name, span_count, dist);
 	}
 
+	void RequestHandler::AddBusToRouter(const BusPtr& bus) {
+		AddBusesToRouter({ bus });
+	}
+
+	void RequestHandler::AddBusesToRouter(const std::vector<BusPtr>& buses) {
+		std::vector<transport::BusRoute> routes(buses.size());
+		parallel::ForEachIndex(buses.size(), [this, &buses, &routes](size_t i) {
+			const std::vector<StopPtr>& route = buses[i]->route;
+			transport::BusRoute& bus_route = routes[i];
+			bus_route.bus_name = buses[i]->name;
+			bus_route.stops.reserve(route.size());
+			bus_route.distances.reserve(route.size());
+			for (size_t j = 0; j < route.size(); ++j) {
+				bus_route.stops.push_back(route[j]->name);
+				if (j > 0) {
+					bus_route.distances.push_back(db_.GetActualDistanceBetweenStops(route[j - 1], route[j]).value_or(0));
+				}
+			}
+		});
+
+		rt_.AddBusRoutes(routes);
+	}
+
 	void RequestHandler::BuildRouter() {
-		rt_.BuildGraph();
-		rt_.BuildRouter();
+		rt_.Commit();
+		Publish();
+	}
+
+	size_t RequestHandler::GetRouterVertexCount() const {
+		return rt_.GetVertexCount();
+	}
+
+	size_t RequestHandler::GetRouterEdgeCount() const {
+		return rt_.GetEdgeCount();
+	}
+
+	memory::Report RequestHandler::GetMemoryReport() const {
+		const auto published = GetPublished();
+		memory::Report report;
+		memory::Append(report, "catalogue."s, published->catalogue->GetMemoryReport());
+		memory::Append(report, "router."s, rt_.GetMemoryReport(published->router));
+
+		return report;
+	}
+
+	void RequestHandler::RemoveBusFromRouter(const std::string_view bus_name) {
+		rt_.RemoveBusEdges(bus_name);
+	}
+
+	void RequestHandler::UpdateDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance) {
+		for (const BusPtr& bus : db_.UpdateDistanceBetweenStops(first, second, distance)) {
+			rt_.RemoveBusEdges(bus->name);
+			AddBusToRouter(bus);
+		}
+	}
+
+	void RequestHandler::SetBusWaitTime(const double bus_wait_time) {
+		rt_.SetWaitTime(bus_wait_time);
+	}
+
+	void RequestHandler::FinalizeCatalogue() {
+		db_.Finalize();
+	}
+
+	void RequestHandler::CommitCatalogue() {
+		db_.Commit();
+		Publish();
+	}
+
+	void RequestHandler::CommitUpdate() {
+		db_.Commit();
+		rt_.Commit();
+		Publish();
 	}
 
 	std::optional<transport::RouteInfo> RequestHandler::GetRouteInfo(const std::string_view from, const std::string_view to) const {
-		return rt_.GetRouteInfo(from, to);
+		return rt_.GetRouteInfo(GetPublished()->router, from, to);
+	}
+
+	std::optional<transport::RouteInfo> RequestHandler::GetRouteInfo(const transport::RoutePoint& from, const transport::RoutePoint& to) const {
+		return rt_.GetRouteInfo(GetPublished()->router, from, to);
+	}
+
+	std::vector<std::optional<transport::RouteInfo>> RequestHandler::GetRouteInfos(const std::string_view from, const std::vector<std::string_view>& to) const {
+		return rt_.GetRouteInfos(GetPublished()->router, from, to);
+	}
+
+	transport::TimeMatrix RequestHandler::GetTotalTimes(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const {
+		return rt_.GetTotalTimes(GetPublished()->router, from, to);
+	}
+
+	std::optional<std::vector<transport::ReachableStop>> RequestHandler::GetReachableStops(const std::string_view from, const double max_time) const {
+		return rt_.GetReachableStops(GetPublished()->router, from, max_time);
+	}
+
+	std::shared_ptr<const RequestHandler::Published> RequestHandler::GetPublished() const {
+		return published_.Load();
+	}
+
+	void RequestHandler::Publish() {
+		published_.Store(std::make_shared<const Published>(Published{ db_.GetSnapshot(), rt_.GetState() }));
+	}
+
+	std::optional<StopStat> RequestHandler::GetStopStat(const transport::TransportCatalogue::SnapshotPtr& snapshot, const std::string_view stop_name) const {
+		StopPtr stop = snapshot->SearchStop(stop_name);
+		if (stop == nullptr) {
+			return {};
+		}
+		const auto* passing_buses = snapshot->GetPassingBusesByStop(stop);
+
+		return std::optional<StopStat>({
+			stop_name,
+			passing_buses ? std::shared_ptr<const std::unordered_set<BusPtr>>(snapshot, passing_buses) : nullptr
+		});
 	}
 
 	std::tuple<std::string, size_t> RequestHandler::QueryGetName(const std::string_view str) const {
@@ -237,7 +367,7 @@ namespace request_handler {
 
 		for (size_t i = 1; i < words.size(); ++i) {
 			StopPtr stop = db_.SearchStop(words[i]);
-			result.push_back(*stop->name.get());
+			result.push_back(stop->name);
 			stops_unique_names.insert(words[i]);
 		}
 
@@ -245,7 +375,7 @@ namespace request_handler {
 			result.reserve(words.size() * 2 - 1);
 			for (int i = words.size() - 2; i >= 1; --i) {
 				StopPtr stop = db_.SearchStop(words[i]);
-				result.push_back(*stop->name.get());
+				result.push_back(stop->name);
 			}
 		}
 
@@ -2,6 +2,8 @@
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
+#include "memory_usage.h"
+#include "parallel.h"
 #include "transport_router.h"
 
 #include <optional>
@@ -28,29 +30,39 @@ namespace request_handler {
 		void AddBus(domain::Bus&& bus);
 		void AddStop(const std::string_view raw_query);
 		void AddStop(domain::Stop&& stop);
+		void AddStops(std::vector<domain::Stop>&& stops);
 
 		void SetDistanceBetweenStops(const std::string_view raw_query);
 		void SetDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance);
+		void SetDistancesBetweenStops(const std::vector<domain::RoadDistance>& distances);
 
 		domain::BusPtr  SearchBus(const std::string_view name)  const;
 		domain::StopPtr SearchStop(const std::string_view name) const;
 
 		const std::vector<domain::BusPtr>  GetBusesInVector() const;
 		const std::vector<domain::StopPtr> GetStopsInVector() const;
+		size_t                             GetBusCount()      const;
+		size_t                             GetStopCount()     const;
 
 		std::optional<domain::BusStat>  GetBusStat(const std::string_view bus_name)   const;
 		std::optional<domain::StopStat> GetStopStat(const std::string_view stop_name) const;
 
-		const std::unordered_set<domain::BusPtr>* GetBusesByStop(const std::string_view stop_name)                const;
-		std::tuple<double, int>                   ComputeRouteLengths(const std::vector<std::string_view>& routh) const;
-		std::vector<domain::StopPtr>              StopsToStopPtr(const std::vector<std::string_view>& stops)      const;
+		std::vector<std::pair<domain::StopPtr, double>> GetNearestStops(geo::Coordinates point, size_t count)  const;
+		std::vector<domain::StopPtr>                    GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
 
-		std::optional<int>                        GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const;
+		std::shared_ptr<const std::unordered_set<domain::BusPtr>> GetBusesByStop(const std::string_view stop_name) const;
+		std::tuple<double, int>      ComputeRouteLengths(const std::vector<std::string_view>& routh) const;
+		std::vector<domain::StopPtr> StopsToStopPtr(const std::vector<std::string_view>& stops)      const;
+
+		std::optional<int>           GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const;
 
 		svg::Document RenderMap() const;
 		void SetRenderSettings(renderer::RenderingSettings&& settings);
 
 		void SetRoutingSettings(const double bus_wait_time, const double bus_velocity);
+		void SetWalkingSettings(const double walking_velocity, const size_t walking_stop_count);
+		void SetRouterMemoryBudget(const size_t memory_budget);
+		void SetRouterExpectedQueryCount(const size_t query_count);
 		void AddStopToRouter(const std::string_view name);
 		void AddWaitEdgeToRouter(const std::string_view stop_name);
 		void AddBusEdgeToRouter(
@@ -60,17 +72,52 @@ namespace request_handler {
 			const int span_count, 
 			const int dist
 		);
+		void AddBusToRouter(const domain::BusPtr& bus);
+		void AddBusesToRouter(const std::vector<domain::BusPtr>& buses);
 		void BuildRouter();
-		std::optional<transport::RouteInfo> GetRouteInfo(const std::string_view from, const std::string_view to) const;
+		size_t GetRouterVertexCount() const;
+		size_t GetRouterEdgeCount()   const;
+
+		// Items of the catalogue and of the router, prefixed with "catalogue." and "router."
+		memory::Report GetMemoryReport() const;
+
+		// Live updates of the built router, applied to the queries by CommitUpdate along with the staged changes
+		// of the catalogue
+		void RemoveBusFromRouter(const std::string_view bus_name);
+		void UpdateDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance);
+		void SetBusWaitTime(const double bus_wait_time);
+		void FinalizeCatalogue();
+		void CommitCatalogue();
+		void CommitUpdate();
+
+		std::optional<transport::RouteInfo> GetRouteInfo(const std::string_view from, const std::string_view to)                          const;
+		std::optional<transport::RouteInfo> GetRouteInfo(const transport::RoutePoint& from, const transport::RoutePoint& to)              const;
+		std::vector<std::optional<transport::RouteInfo>> GetRouteInfos(const std::string_view from, const std::vector<std::string_view>& to) const;
+		transport::TimeMatrix               GetTotalTimes(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const;
+
+		std::optional<std::vector<transport::ReachableStop>> GetReachableStops(const std::string_view from, const double max_time) const;
 
 	private:
-		transport::TransportCatalogue& db_;
-		renderer::MapRenderer&         mr_;
-		transport::Router              rt_;
+		// The catalogue and the router as they were committed together. The queries read both through
+		// one pointer, so none of them sees the catalogue of an update with the router from before it.
+		struct Published {
+			transport::TransportCatalogue::SnapshotPtr catalogue;
+			transport::Router::StatePtr                router;
+		};
+
+		transport::TransportCatalogue&          db_;
+		renderer::MapRenderer&                  mr_;
+		transport::Router                       rt_;
+		parallel::PublishedPtr<const Published> published_;
+
+		std::shared_ptr<const Published> GetPublished() const;
+		void                             Publish();
 
 		std::tuple<std::string, std::size_t>                QueryGetName(const std::string_view str)                                     const;
 		std::tuple<std::string, std::string>                SplitIntoLengthStop(std::string&& str)                                       const;
 		std::tuple<std::vector<std::string>, SeparatorType> SplitIntoWordsBySeparator(const std::string_view str)                        const;
 		std::tuple<std::vector<std::string_view>, int>      WordsToRoute(const std::vector<std::string>& words, SeparatorType separator) const;
+
+		std::optional<domain::StopStat> GetStopStat(const transport::TransportCatalogue::SnapshotPtr& snapshot, const std::string_view stop_name) const;
 	};
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "graph.h"
+#include "shortest_paths.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
 #include <unordered_map>
@@ -14,119 +17,280 @@
 
 namespace graph {
 
-	template<typename Weight>
+	// Difference between two versions of a graph over the same vertices
+	struct EdgesUpdate {
+		// Old edge id -> new edge id, empty for the removed edges
+		std::vector<std::optional<EdgeId>> new_edge_ids;
+		// New ids of the kept edges that became heavier
+		std::vector<EdgeId> heavier_edges;
+		// New ids of the added edges and of the kept edges that became lighter
+		std::vector<EdgeId> lighter_edges;
+	};
+
+	// TableWeight and TableEdgeId set the storage of the all-pairs table: one flat V*V array
+	// where an unreachable pair holds an infinite weight and a missing edge holds the max id.
+	template<typename Weight, typename TableWeight = Weight, typename TableEdgeId = EdgeId>
 	class Router {
 	private:
 		using Graph = DirectedWeightedGraph<Weight>;
 
 	public:
 		explicit Router(const Graph& graph);
+		// Reuses the table of prev, built for the previous version of the graph.
+		// Only the rows whose routes lost an edge are searched again, then the table is
+		// relaxed through the lighter edges. Falls back to a full build when that is cheaper.
+		Router(const Graph& graph, const Router& prev, const EdgesUpdate& update);
 
 		struct RouteInfo {
 			Weight weight;
 			std::vector<EdgeId> edges;
 		};
 
-		std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+		std::optional<RouteInfo>            BuildRoute(VertexId from, VertexId to) const;
+		std::vector<std::optional<Weight>> BuildWeightsFrom(VertexId from)        const;
+
+		// Of the V*V table
+		size_t GetMemoryUsage() const {
+			return routes_internal_data_.capacity() * sizeof(RouteInternalData);
+		}
+		static constexpr size_t GetTableCellSize() {
+			return sizeof(RouteInternalData);
+		}
 
 	private:
+		static_assert(std::numeric_limits<TableWeight>::has_infinity, "Table weight should have an infinity");
+
+		static constexpr TableWeight UNREACHABLE_WEIGHT = std::numeric_limits<TableWeight>::infinity();
+		static constexpr TableEdgeId NO_EDGE            = std::numeric_limits<TableEdgeId>::max();
+
 		struct RouteInternalData {
-			Weight weight;
-			std::optional<EdgeId> prev_edge;
+			TableWeight weight    = UNREACHABLE_WEIGHT;
+			TableEdgeId prev_edge = NO_EDGE;
 		};
-		using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+		using RoutesInternalData = std::vector<RouteInternalData>;
+
+		static bool IsReachable(const RouteInternalData& data) {
+			return data.weight < UNREACHABLE_WEIGHT;
+		}
+
+		RouteInternalData& GetRouteInternalData(VertexId from, VertexId to) {
+			return routes_internal_data_[from * vertex_count_ + to];
+		}
+
+		const RouteInternalData& GetRouteInternalData(VertexId from, VertexId to) const {
+			return routes_internal_data_[from * vertex_count_ + to];
+		}
 
 		void InitializeRoutesInternalData(const Graph& graph) {
-			const size_t vertex_count = graph.GetVertexCount();
-			for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-				routes_internal_data_[vertex][vertex] = RouteInternalData{ ZERO_WEIGHT, std::nullopt };
+			if (graph.GetEdgeCount() >= static_cast<size_t>(NO_EDGE)) {
+				throw std::length_error("Too many edges for the routes table");
+			}
+			for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+				GetRouteInternalData(vertex, vertex) = RouteInternalData{ ZERO_WEIGHT, NO_EDGE };
 				for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
 					const auto& edge = graph.GetEdge(edge_id);
 					if (edge.weight < ZERO_WEIGHT) {
 						throw std::domain_error("Edges' weights should be non-negative");
 					}
-					auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-					if (!route_internal_data || route_internal_data->weight > edge.weight) {
-						route_internal_data = RouteInternalData{ edge.weight, edge_id };
+					const TableWeight edge_weight = static_cast<TableWeight>(edge.weight);
+					auto& route_internal_data = GetRouteInternalData(vertex, edge.to);
+					if (route_internal_data.weight > edge_weight) {
+						route_internal_data = RouteInternalData{ edge_weight, static_cast<TableEdgeId>(edge_id) };
 					}
 				}
 			}
 		}
 
-		void RelaxRoute(
-			VertexId vertex_from, 
-			VertexId vertex_to, 
-			const RouteInternalData& route_from,
-			const RouteInternalData& route_to
-		) {
-			auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-			const Weight candidate_weight = route_from.weight + route_to.weight;
-			if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-				route_relaxing = { 
-					candidate_weight,
-					route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge 
-				};
+		void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through) {
+			const RouteInternalData* const row_through = &GetRouteInternalData(vertex_through, 0);
+			for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+				RouteInternalData* const row_from = &GetRouteInternalData(vertex_from, 0);
+				const RouteInternalData route_from = row_from[vertex_through];
+				if (!IsReachable(route_from)) {
+					continue;
+				}
+				for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+					const RouteInternalData& route_to = row_through[vertex_to];
+					const TableWeight candidate_weight = route_from.weight + route_to.weight;
+					if (candidate_weight < row_from[vertex_to].weight) {
+						row_from[vertex_to] = {
+							candidate_weight,
+							route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge
+						};
+					}
+				}
 			}
 		}
 
-		void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-			for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-				if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-					for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-						if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-							RelaxRoute(
-								vertex_from, 
-								vertex_to, 
-								*route_from, 
-								*route_to
-							);
-						}
+		void RelaxRoutesInternalDataThroughEdge(EdgeId edge_id) {
+			const auto& edge = graph_.GetEdge(edge_id);
+			const TableWeight edge_weight = static_cast<TableWeight>(edge.weight);
+			const RouteInternalData* const row_through = &GetRouteInternalData(edge.to, 0);
+			for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+				RouteInternalData* const row_from = &GetRouteInternalData(vertex_from, 0);
+				const RouteInternalData route_from = row_from[edge.from];
+				if (!IsReachable(route_from)) {
+					continue;
+				}
+				const TableWeight through_weight = route_from.weight + edge_weight;
+				for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+					const RouteInternalData& route_to = row_through[vertex_to];
+					const TableWeight candidate_weight = through_weight + route_to.weight;
+					if (candidate_weight < row_from[vertex_to].weight) {
+						row_from[vertex_to] = {
+							candidate_weight,
+							route_to.prev_edge != NO_EDGE ? route_to.prev_edge : static_cast<TableEdgeId>(edge_id)
+						};
 					}
 				}
 			}
 		}
 
+		void RebuildRoutesInternalDataFrom(VertexId vertex_from) {
+			const ShortestPathTree<Weight> tree(graph_, vertex_from);
+			RouteInternalData* const row_from = &GetRouteInternalData(vertex_from, 0);
+			for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+				const auto weight = tree.GetWeight(vertex_to);
+				const auto prev_edge = tree.GetPrevEdge(vertex_to);
+				row_from[vertex_to] = weight
+					? RouteInternalData{ static_cast<TableWeight>(*weight), prev_edge ? static_cast<TableEdgeId>(*prev_edge) : NO_EDGE }
+					: RouteInternalData{};
+			}
+		}
+
+		void BuildRoutesInternalData() {
+			InitializeRoutesInternalData(graph_);
+			for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+				RelaxRoutesInternalDataThroughVertex(vertex_through);
+			}
+		}
+
 		static constexpr Weight ZERO_WEIGHT{};
 		const Graph& graph_;
+		size_t vertex_count_;
 		RoutesInternalData routes_internal_data_;
 	};
 
+	// 8 bytes per table cell instead of 32: float weights and 32-bit edge ids.
 	template<typename Weight>
-	Router<Weight>::Router(const Graph& graph)
+	using CompactRouter = Router<Weight, float, std::uint32_t>;
+
+	template<typename Weight, typename TableWeight, typename TableEdgeId>
+	Router<Weight, TableWeight, TableEdgeId>::Router(const Graph& graph)
 		: graph_(graph)
-		, routes_internal_data_(
-			graph.GetVertexCount(), 
-			std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount())
-		)
+		, vertex_count_(graph.GetVertexCount())
+		, routes_internal_data_(vertex_count_ * vertex_count_)
 	{
-		InitializeRoutesInternalData(graph);
+		BuildRoutesInternalData();
+	}
+
+	template<typename Weight, typename TableWeight, typename TableEdgeId>
+	Router<Weight, TableWeight, TableEdgeId>::Router(const Graph& graph, const Router& prev, const EdgesUpdate& update)
+		: graph_(graph)
+		, vertex_count_(graph.GetVertexCount())
+		, routes_internal_data_(prev.routes_internal_data_)
+	{
+		if (prev.vertex_count_ != vertex_count_) {
+			throw std::invalid_argument("Routes table can be updated only for the same vertices");
+		}
+		if (graph.GetEdgeCount() >= static_cast<size_t>(NO_EDGE)) {
+			throw std::length_error("Too many edges for the routes table");
+		}
+
+		std::vector<bool> is_heavier(graph.GetEdgeCount());
+		for (const EdgeId edge_id : update.heavier_edges) {
+			is_heavier.at(edge_id) = true;
+		}
 
-		const size_t vertex_count = graph.GetVertexCount();
-		for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-			RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+		std::vector<VertexId> outdated_rows;
+		for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+			RouteInternalData* const row_from = &GetRouteInternalData(vertex_from, 0);
+			bool is_outdated = false;
+			for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+				TableEdgeId& prev_edge = row_from[vertex_to].prev_edge;
+				if (prev_edge == NO_EDGE) {
+					continue;
+				}
+				const auto new_edge_id = update.new_edge_ids.at(prev_edge);
+				is_outdated = is_outdated || !new_edge_id || is_heavier[*new_edge_id];
+				prev_edge = new_edge_id ? static_cast<TableEdgeId>(*new_edge_id) : NO_EDGE;
+			}
+			if (is_outdated) {
+				outdated_rows.push_back(vertex_from);
+			}
+		}
+
+		const double vertex_count = static_cast<double>(vertex_count_);
+		const double search_cost  = (graph.GetEdgeCount() + vertex_count) * std::log2(vertex_count + 2);
+		const double update_cost  = outdated_rows.size() * search_cost + update.lighter_edges.size() * vertex_count * vertex_count;
+		if (update_cost >= vertex_count * vertex_count * vertex_count) {
+			std::fill(routes_internal_data_.begin(), routes_internal_data_.end(), RouteInternalData{});
+			BuildRoutesInternalData();
+			return;
+		}
+
+		for (const VertexId vertex_from : outdated_rows) {
+			RebuildRoutesInternalDataFrom(vertex_from);
+		}
+		for (const EdgeId edge_id : update.lighter_edges) {
+			RelaxRoutesInternalDataThroughEdge(edge_id);
 		}
 	}
 
-	template<typename Weight>
-	std::optional<typename Router<Weight>::RouteInfo> 
-		Router<Weight>::BuildRoute(VertexId from, VertexId to) const 
+	template<typename Weight, typename TableWeight, typename TableEdgeId>
+	std::optional<typename Router<Weight, TableWeight, TableEdgeId>::RouteInfo>
+		Router<Weight, TableWeight, TableEdgeId>::BuildRoute(VertexId from, VertexId to) const
 	{
-		const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-		if (!route_internal_data) {
+		if (from >= vertex_count_ || to >= vertex_count_) {
+			throw std::out_of_range("Vertex is out of the routes table");
+		}
+		const auto& route_internal_data = GetRouteInternalData(from, to);
+		if (!IsReachable(route_internal_data)) {
 			return std::nullopt;
 		}
-		const Weight weight = route_internal_data->weight;
+		// The table weight may be narrowed, so the exact weight is summed over the graph edges
+		Weight weight = ZERO_WEIGHT;
 		std::vector<EdgeId> edges;
 		for (
-			std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-			edge_id;
-			edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge
+			TableEdgeId edge_id = route_internal_data.prev_edge;
+			edge_id != NO_EDGE;
+			edge_id = GetRouteInternalData(from, graph_.GetEdge(edge_id).from).prev_edge
 		) {
-			edges.push_back(*edge_id);
+			edges.push_back(edge_id);
+			weight += graph_.GetEdge(edge_id).weight;
 		}
 		std::reverse(edges.begin(), edges.end());
 
 		return RouteInfo{ weight, std::move(edges) };
 	}
 
+	template<typename Weight, typename TableWeight, typename TableEdgeId>
+	std::vector<std::optional<Weight>> Router<Weight, TableWeight, TableEdgeId>::BuildWeightsFrom(VertexId from) const {
+		if (from >= vertex_count_) {
+			throw std::out_of_range("Vertex is out of the routes table");
+		}
+		std::vector<std::optional<Weight>> weights(vertex_count_);
+		weights[from] = ZERO_WEIGHT;
+
+		// Every vertex is resolved once: the walk back stops at the first vertex with a known weight
+		std::vector<VertexId> unresolved;
+		for (VertexId to = 0; to < vertex_count_; ++to) {
+			if (weights[to] || !IsReachable(GetRouteInternalData(from, to))) {
+				continue;
+			}
+			for (VertexId vertex = to; !weights[vertex]; ) {
+				unresolved.push_back(vertex);
+				vertex = graph_.GetEdge(GetRouteInternalData(from, vertex).prev_edge).from;
+			}
+			Weight weight = *weights[graph_.GetEdge(GetRouteInternalData(from, unresolved.back()).prev_edge).from];
+			for (auto it = unresolved.rbegin(); it != unresolved.rend(); ++it) {
+				weight += graph_.GetEdge(GetRouteInternalData(from, *it).prev_edge).weight;
+				weights[*it] = weight;
+			}
+			unresolved.clear();
+		}
+
+		return weights;
+	}
+
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+	// Single-source shortest paths: the weight of the best route to every vertex and its last edge.
+	// Graph is DirectedWeightedGraph or GraphOverlay over it.
+	template<typename Weight, typename Graph = DirectedWeightedGraph<Weight>>
+	class ShortestPathTree {
+	public:
+		struct RouteInfo {
+			Weight weight;
+			std::vector<EdgeId> edges;
+		};
+
+		// With max_weight set, the search stops at the vertices farther than max_weight,
+		// they are reported as unreachable
+		ShortestPathTree(const Graph& graph, VertexId from, std::optional<Weight> max_weight = std::nullopt);
+
+		VertexId                                  GetSource()              const;
+		const std::vector<std::optional<Weight>>& GetWeights()             const;
+		std::optional<Weight>                     GetWeight(VertexId to)   const;
+		std::optional<EdgeId>                     GetPrevEdge(VertexId to) const;
+		std::optional<RouteInfo>                  BuildRoute(VertexId to)  const;
+
+	private:
+		static constexpr Weight ZERO_WEIGHT{};
+
+		const Graph& graph_;
+		VertexId from_;
+		std::vector<std::optional<Weight>> weights_;
+		std::vector<std::optional<EdgeId>> prev_edges_;
+	};
+
+	template<typename Weight, typename Graph>
+	ShortestPathTree<Weight, Graph>::ShortestPathTree(const Graph& graph, VertexId from, std::optional<Weight> max_weight)
+		: graph_(graph)
+		, from_(from)
+		, weights_(graph.GetVertexCount())
+		, prev_edges_(graph.GetVertexCount())
+	{
+		using QueueItem = std::pair<Weight, VertexId>;
+		std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+		std::vector<bool> settled(graph.GetVertexCount());
+		weights_.at(from) = ZERO_WEIGHT;
+		queue.push({ ZERO_WEIGHT, from });
+
+		while (!queue.empty()) {
+			const auto [weight, vertex] = queue.top();
+			queue.pop();
+			if (settled[vertex]) {
+				continue;
+			}
+			settled[vertex] = true;
+
+			ForEachIncidentEdge(graph, vertex, [&, weight = weight](EdgeId edge_id) {
+				const auto& edge = graph.GetEdge(edge_id);
+				if (edge.weight < ZERO_WEIGHT) {
+					throw std::domain_error("Edges' weights should be non-negative");
+				}
+				const Weight candidate_weight = weight + edge.weight;
+				if (max_weight && *max_weight < candidate_weight) {
+					return;
+				}
+				auto& to_weight = weights_[edge.to];
+				if (!to_weight || candidate_weight < *to_weight) {
+					to_weight = candidate_weight;
+					prev_edges_[edge.to] = edge_id;
+					queue.push({ candidate_weight, edge.to });
+				}
+			});
+		}
+	}
+
+	template<typename Weight, typename Graph>
+	VertexId ShortestPathTree<Weight, Graph>::GetSource() const {
+		return from_;
+	}
+
+	template<typename Weight, typename Graph>
+	const std::vector<std::optional<Weight>>& ShortestPathTree<Weight, Graph>::GetWeights() const {
+		return weights_;
+	}
+
+	template<typename Weight, typename Graph>
+	std::optional<Weight> ShortestPathTree<Weight, Graph>::GetWeight(VertexId to) const {
+		return weights_.at(to);
+	}
+
+	template<typename Weight, typename Graph>
+	std::optional<EdgeId> ShortestPathTree<Weight, Graph>::GetPrevEdge(VertexId to) const {
+		return prev_edges_.at(to);
+	}
+
+	template<typename Weight, typename Graph>
+	std::optional<typename ShortestPathTree<Weight, Graph>::RouteInfo> ShortestPathTree<Weight, Graph>::BuildRoute(VertexId to) const {
+		if (!weights_.at(to)) {
+			return std::nullopt;
+		}
+		std::vector<EdgeId> edges;
+		for (
+			std::optional<EdgeId> edge_id = prev_edges_[to];
+			edge_id;
+			edge_id = prev_edges_[graph_.GetEdge(*edge_id).from]
+		) {
+			edges.push_back(*edge_id);
+		}
+		std::reverse(edges.begin(), edges.end());
+
+		return RouteInfo{ *weights_[to], std::move(edges) };
+	}
+}
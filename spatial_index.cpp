@@ -0,0 +1,166 @@
+#define _USE_MATH_DEFINES
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace spatial {
+
+	namespace {
+		constexpr double EARTH_RADIUS = 6371000;
+		constexpr double DR           = M_PI / 180.0;
+		// geo::ComputeDistance is computed through acos and may be off by a fraction of a meter
+		constexpr double TOLERANCE    = 1.0;
+
+		double ComputeMeters(geo::Coordinates from, geo::Coordinates to) {
+			const double distance = geo::ComputeDistance(from, to);
+			// acos of a value rounded above 1 for the same point
+			return std::isnan(distance) ? 0. : distance;
+		}
+
+		bool IsCloser(const Neighbor& lhs, const Neighbor& rhs) {
+			return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+		}
+	}
+
+	PointIndex::PointIndex(const std::vector<geo::Coordinates>& points)
+		: points_(points)
+		, ids_(points.size())
+	{
+		if (points.size() > UINT32_MAX) {
+			throw std::length_error("Too many points for the spatial index");
+		}
+		std::iota(ids_.begin(), ids_.end(), 0u);
+		if (!points.empty()) {
+			const auto [min_it, max_it] = std::minmax_element(points.begin(), points.end(),
+				[](geo::Coordinates lhs, geo::Coordinates rhs) {
+					return lhs.lng < rhs.lng;
+				}
+			);
+			is_longitude_bounded_ = max_it->lng - min_it->lng < 180.;
+		}
+		Build(0, points_.size(), true);
+	}
+
+	size_t PointIndex::GetSize() const {
+		return points_.size();
+	}
+
+	size_t PointIndex::GetMemoryUsage() const {
+		return points_.capacity() * sizeof(geo::Coordinates) + ids_.capacity() * sizeof(std::uint32_t);
+	}
+
+	std::vector<Neighbor> PointIndex::FindNearest(geo::Coordinates point, size_t count) const {
+		std::vector<Neighbor> heap;
+		if (count == 0) {
+			return heap;
+		}
+		heap.reserve(std::min(count, points_.size()));
+		SearchNearest(0, points_.size(), true, point, count, heap);
+		std::sort_heap(heap.begin(), heap.end(), IsCloser);
+
+		return heap;
+	}
+
+	std::vector<size_t> PointIndex::FindInBox(geo::Coordinates min, geo::Coordinates max) const {
+		std::vector<size_t> result;
+		SearchInBox(0, points_.size(), true, min, max, result);
+
+		return result;
+	}
+
+	void PointIndex::Build(size_t begin, size_t end, bool by_latitude) {
+		if (end - begin < 2) {
+			return;
+		}
+		const size_t middle = begin + (end - begin) / 2;
+
+		std::vector<size_t> order(end - begin);
+		std::iota(order.begin(), order.end(), begin);
+		std::nth_element(order.begin(), order.begin() + (middle - begin), order.end(),
+			[this, by_latitude](size_t lhs, size_t rhs) {
+				return by_latitude ? points_[lhs].lat < points_[rhs].lat : points_[lhs].lng < points_[rhs].lng;
+			}
+		);
+
+		std::vector<geo::Coordinates> points;
+		std::vector<std::uint32_t> ids;
+		points.reserve(order.size());
+		ids.reserve(order.size());
+		for (const size_t i : order) {
+			points.push_back(points_[i]);
+			ids.push_back(ids_[i]);
+		}
+		std::copy(points.begin(), points.end(), points_.begin() + begin);
+		std::copy(ids.begin(), ids.end(), ids_.begin() + begin);
+
+		Build(begin, middle, !by_latitude);
+		Build(middle + 1, end, !by_latitude);
+	}
+
+	void PointIndex::SearchNearest(size_t begin, size_t end, bool by_latitude, geo::Coordinates point, size_t count, std::vector<Neighbor>& heap) const {
+		if (begin >= end) {
+			return;
+		}
+		const size_t middle = begin + (end - begin) / 2;
+		const geo::Coordinates split = points_[middle];
+
+		const Neighbor candidate{ ids_[middle], ComputeMeters(point, split) };
+		if (heap.size() < count) {
+			heap.push_back(candidate);
+			std::push_heap(heap.begin(), heap.end(), IsCloser);
+		} else if (IsCloser(candidate, heap.front())) {
+			std::pop_heap(heap.begin(), heap.end(), IsCloser);
+			heap.back() = candidate;
+			std::push_heap(heap.begin(), heap.end(), IsCloser);
+		}
+
+		const bool is_left_near = by_latitude ? point.lat < split.lat : point.lng < split.lng;
+		if (is_left_near) {
+			SearchNearest(begin, middle, !by_latitude, point, count, heap);
+		} else {
+			SearchNearest(middle + 1, end, !by_latitude, point, count, heap);
+		}
+		if (heap.size() < count || GetDistanceToSplit(point, split, by_latitude) - TOLERANCE <= heap.front().distance) {
+			if (is_left_near) {
+				SearchNearest(middle + 1, end, !by_latitude, point, count, heap);
+			} else {
+				SearchNearest(begin, middle, !by_latitude, point, count, heap);
+			}
+		}
+	}
+
+	void PointIndex::SearchInBox(size_t begin, size_t end, bool by_latitude, geo::Coordinates min, geo::Coordinates max, std::vector<size_t>& result) const {
+		if (begin >= end) {
+			return;
+		}
+		const size_t middle = begin + (end - begin) / 2;
+		const geo::Coordinates split = points_[middle];
+
+		if (min.lat <= split.lat && split.lat <= max.lat && min.lng <= split.lng && split.lng <= max.lng) {
+			result.push_back(ids_[middle]);
+		}
+		const double split_value = by_latitude ? split.lat : split.lng;
+		if ((by_latitude ? min.lat : min.lng) <= split_value) {
+			SearchInBox(begin, middle, !by_latitude, min, max, result);
+		}
+		if (split_value <= (by_latitude ? max.lat : max.lng)) {
+			SearchInBox(middle + 1, end, !by_latitude, min, max, result);
+		}
+	}
+
+	double PointIndex::GetDistanceToSplit(geo::Coordinates point, geo::Coordinates split, bool by_latitude) const {
+		if (by_latitude) {
+			// No route to the other side of a parallel is shorter than the latitude difference
+			return std::abs(point.lat - split.lat) * DR * EARTH_RADIUS;
+		}
+		const double delta_lng = std::abs(point.lng - split.lng);
+		if (!is_longitude_bounded_ || delta_lng >= 90.) {
+			return 0.;
+		}
+		// Distance to the great circle of the splitting meridian
+		return std::asin(std::sin(delta_lng * DR) * std::cos(point.lat * DR)) * EARTH_RADIUS;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace spatial {
+
+	struct Neighbor {
+		size_t id;
+		double distance;
+	};
+
+	// Static 2-d tree over latitude/longitude kept in flat arrays: the subtree of a range [begin, end)
+	// is rooted at its middle element and split by latitude on even depths, by longitude on odd ones
+	class PointIndex {
+	public:
+		PointIndex() = default;
+		explicit PointIndex(const std::vector<geo::Coordinates>& points);
+
+		size_t                GetSize()                                                  const;
+		size_t                GetMemoryUsage()                                           const;
+		// Sorted by the distance in meters
+		std::vector<Neighbor> FindNearest(geo::Coordinates point, size_t count)           const;
+		std::vector<size_t>   FindInBox(geo::Coordinates min, geo::Coordinates max)       const;
+
+	private:
+		std::vector<geo::Coordinates> points_;
+		std::vector<std::uint32_t>    ids_;
+		// The longitude bound is valid only when all points fit in half of the globe
+		bool is_longitude_bounded_ = true;
+
+		void Build(size_t begin, size_t end, bool by_latitude);
+		void SearchNearest(size_t begin, size_t end, bool by_latitude, geo::Coordinates point, size_t count, std::vector<Neighbor>& heap) const;
+		void SearchInBox(size_t begin, size_t end, bool by_latitude, geo::Coordinates min, geo::Coordinates max, std::vector<size_t>& result) const;
+		double GetDistanceToSplit(geo::Coordinates point, geo::Coordinates split, bool by_latitude)                                      const;
+	};
+}
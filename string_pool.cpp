@@ -0,0 +1,53 @@
+#include "string_pool.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+
+namespace strings {
+
+	std::string_view StringPool::Intern(std::string_view str) {
+		if (str.empty()) {
+			return {};
+		}
+		if (const auto it = strings_.find(str); it != strings_.end()) {
+			return *it;
+		}
+		char* data = Allocate(str.size());
+		std::copy(str.begin(), str.end(), data);
+		const std::string_view result(data, str.size());
+		strings_.insert(result);
+
+		return result;
+	}
+
+	size_t StringPool::GetCount() const {
+		return strings_.size();
+	}
+
+	size_t StringPool::GetAllocatedSize() const {
+		return allocated_;
+	}
+
+	size_t StringPool::GetMemoryUsage() const {
+		return allocated_ + memory::GetVectorBytes(blocks_) + memory::GetNodeContainerBytes(strings_);
+	}
+
+	char* StringPool::Allocate(size_t size) {
+		// Long strings get a block of their own, so that a block never wastes more than a short string
+		if (size > BLOCK_SIZE / 4) {
+			blocks_.push_back(std::make_unique<char[]>(size));
+			allocated_ += size;
+			return blocks_.back().get();
+		}
+		if (size > block_free_) {
+			blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+			allocated_ += BLOCK_SIZE;
+			block_      = blocks_.back().get();
+			block_free_ = BLOCK_SIZE;
+		}
+		char* result = block_ + (BLOCK_SIZE - block_free_);
+		block_free_ -= size;
+
+		return result;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace strings {
+
+	// Append-only arena of unique strings: an interned view stays valid while the pool lives.
+	// Interning is for a single writer, the views may be read from any thread.
+	class StringPool {
+	public:
+		StringPool() = default;
+
+		StringPool(const StringPool&) = delete;
+		StringPool& operator=(const StringPool&) = delete;
+
+		std::string_view Intern(std::string_view str);
+
+		size_t GetCount()         const;
+		size_t GetAllocatedSize() const;
+		// The blocks and the lookup set
+		size_t GetMemoryUsage()   const;
+
+	private:
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+		std::vector<std::unique_ptr<char[]>>                              blocks_;
+		// The block short strings are appended to
+		char*                                                             block_      = nullptr;
+		size_t                                                            block_free_ = 0;
+		size_t                                                            allocated_  = 0;
+		std::unordered_set<std::string_view, std::hash<std::string_view>> strings_;
+
+		char* Allocate(size_t size);
+	};
+}
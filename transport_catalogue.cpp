@@ -4,10 +4,12 @@
 #include <utility>
 #include <set>
 #include <cmath>
+#include <algorithm>
 
 namespace transport {
 
 	using namespace domain;
+	using namespace std::literals;
 
 	size_t TransportCatalogue::StopsPairHasher::operator()(const StopsPair& stops_pair) const {
 		return {
@@ -16,54 +18,393 @@ namespace transport {
 		};
 	}
 
+	namespace {
+
+		// Null if a name is given to several items: the directory can't tell them apart,
+		// the name map is kept and the last item with the name is found
+		template<typename Ptr>
+		std::shared_ptr<const containers::MinimalPerfectHash> MakeNameDirectory(const std::deque<Ptr>& items) {
+			std::vector<std::string_view> names;
+			names.reserve(items.size());
+			for (const auto& item : items) {
+				names.push_back(item->name);
+			}
+			std::vector<std::string_view> sorted_names = names;
+			std::sort(sorted_names.begin(), sorted_names.end());
+			if (std::adjacent_find(sorted_names.begin(), sorted_names.end()) != sorted_names.end()) {
+				return nullptr;
+			}
+			return std::make_shared<const containers::MinimalPerfectHash>(names);
+		}
+
+		template<typename Ptr>
+		Ptr FindInDirectory(const containers::MinimalPerfectHash& directory, const std::deque<Ptr>& items, const std::string_view name) {
+			if (items.empty()) {
+				return nullptr;
+			}
+			const Ptr& item = items[directory.Find(name)];
+			return (item->name == name ? item : nullptr);
+		}
+
+		BusStat MakeBusStat(const Bus& bus) {
+			return {
+				bus.name,
+				static_cast<int>(bus.route.size()),
+				bus.unique_stops,
+				bus.route_actual_length,
+				bus.route_actual_length / bus.route_geographic_length
+			};
+		}
+	}
+
+	StopPtr TransportCatalogue::StopsIndex::Find(const std::string_view name) const {
+		if (name_directory) {
+			return FindInDirectory(*name_directory, stops, name);
+		}
+		const auto it = name_to_stop.find(name);
+		return (it != name_to_stop.end() ? it->second : nullptr);
+	}
+
+	void TransportCatalogue::StopsIndex::Finalize() {
+		name_directory = MakeNameDirectory(stops);
+		if (name_directory) {
+			name_to_stop = {};
+		}
+	}
+
+	void TransportCatalogue::StopsIndex::Thaw() {
+		if (!name_directory) {
+			return;
+		}
+		name_to_stop.reserve(stops.size());
+		for (const auto& stop : stops) {
+			name_to_stop[stop->name] = stop;
+		}
+		name_directory.reset();
+	}
+
+	BusPtr TransportCatalogue::BusesIndex::Find(const std::string_view name) const {
+		if (name_directory) {
+			return FindInDirectory(*name_directory, buses, name);
+		}
+		const auto it = name_to_bus.find(name);
+		return (it != name_to_bus.end() ? it->second : nullptr);
+	}
+
+	std::optional<BusStat> TransportCatalogue::BusesIndex::FindStat(const std::string_view name) const {
+		if (name_directory && !stats.empty()) {
+			const BusStat& stat = stats[name_directory->Find(name)];
+			return (stat.name == name ? stat : std::optional<BusStat>{});
+		}
+		const BusPtr bus = Find(name);
+		return (bus != nullptr ? MakeBusStat(*bus) : std::optional<BusStat>{});
+	}
+
+	void TransportCatalogue::BusesIndex::UpdateStats() {
+		stats.clear();
+		if (!name_directory) {
+			return;
+		}
+		stats.reserve(buses.size());
+		for (const auto& bus : buses) {
+			stats.push_back(MakeBusStat(*bus));
+		}
+	}
+
+	void TransportCatalogue::BusesIndex::Finalize() {
+		name_directory = MakeNameDirectory(buses);
+		if (name_directory) {
+			name_to_bus = {};
+		}
+	}
+
+	void TransportCatalogue::BusesIndex::Thaw() {
+		if (!name_directory) {
+			return;
+		}
+		name_to_bus.reserve(buses.size());
+		for (const auto& bus : buses) {
+			name_to_bus[bus->name] = bus;
+		}
+		name_directory.reset();
+	}
+
+	const std::unordered_set<BusPtr>* TransportCatalogue::BusesIndex::FindPassingBuses(StopPtr stop) const {
+		const auto it = stop_to_passing_buses.find(stop);
+		return (it != stop_to_passing_buses.end() ? &it->second : nullptr);
+	}
+
+	std::optional<int> TransportCatalogue::DistancesIndex::Find(StopPtr first, StopPtr second) const {
+		if (first.get() == nullptr || second.get() == nullptr) {
+			return {};
+		}
+		const auto it = stops_pair_to_distance.find({ first, second });
+
+		return (it != stops_pair_to_distance.end() ? it->second : std::optional<int>{});
+	}
+
+	BusPtr TransportCatalogue::Snapshot::SearchBus(const std::string_view name) const {
+		return buses_->Find(name);
+	}
+
+	StopPtr TransportCatalogue::Snapshot::SearchStop(const std::string_view name) const {
+		return stops_->Find(name);
+	}
+
+	std::optional<BusStat> TransportCatalogue::Snapshot::GetBusStat(const std::string_view name) const {
+		return buses_->FindStat(name);
+	}
+
+	std::optional<int> TransportCatalogue::Snapshot::GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const {
+		return distances_->Find(stops_->Find(stop1_name), stops_->Find(stop2_name));
+	}
+
+	std::optional<double> TransportCatalogue::Snapshot::GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const {
+		StopPtr first_stop = stops_->Find(stop1_name);
+		StopPtr second_stop = stops_->Find(stop2_name);
+		if (first_stop == nullptr || second_stop == nullptr) {
+			return {};
+		}
+
+		return first_stop->GetGeographicDistanceTo(second_stop);
+	}
+
+	const std::unordered_set<BusPtr>* TransportCatalogue::Snapshot::GetPassingBusesByStop(StopPtr stop) const {
+		return buses_->FindPassingBuses(stop);
+	}
+
+	const std::vector<BusPtr> TransportCatalogue::Snapshot::GetBusesInVector() const {
+		return std::vector<BusPtr>(buses_->buses.begin(), buses_->buses.end());
+	}
+
+	const std::vector<StopPtr> TransportCatalogue::Snapshot::GetStopsInVector() const {
+		return std::vector<StopPtr>(stops_->stops.begin(), stops_->stops.end());
+	}
+
+	size_t TransportCatalogue::Snapshot::GetBusCount() const {
+		return buses_->buses.size();
+	}
+
+	size_t TransportCatalogue::Snapshot::GetStopCount() const {
+		return stops_->stops.size();
+	}
+
+	memory::Report TransportCatalogue::Snapshot::GetMemoryReport() const {
+		// A shared pointer made by make_shared holds the object next to the two reference counters
+		constexpr size_t SHARED_COUNTERS_SIZE = 2 * sizeof(long);
+
+		size_t stops_size = stops_->stops.size() * (sizeof(std::shared_ptr<Stop>) + sizeof(Stop) + SHARED_COUNTERS_SIZE);
+		size_t buses_size = buses_->buses.size() * (sizeof(std::shared_ptr<Bus>) + sizeof(Bus) + SHARED_COUNTERS_SIZE);
+		for (const auto& bus : buses_->buses) {
+			buses_size += memory::GetVectorBytes(bus->route);
+		}
+		buses_size += memory::GetVectorBytes(buses_->stats);
+		size_t passing_buses_size = buses_->stop_to_passing_buses.GetMemoryUsage();
+		for (const auto& [stop, passing_buses] : buses_->stop_to_passing_buses) {
+			passing_buses_size += memory::GetNodeContainerBytes(passing_buses);
+		}
+
+		return {
+			{ "names"s,               names_memory_usage_                                                                          },
+			{ "stops"s,               stops_size                                                                                   },
+			{ "stop_names_index"s,    stops_->name_to_stop.GetMemoryUsage() + (stops_->name_directory ? stops_->name_directory->GetMemoryUsage() : 0) },
+			{ "stops_spatial_index"s, stops_spatial_index_->GetMemoryUsage()                                                       },
+			{ "buses"s,               buses_size                                                                                   },
+			{ "bus_names_index"s,     buses_->name_to_bus.GetMemoryUsage() + (buses_->name_directory ? buses_->name_directory->GetMemoryUsage() : 0) },
+			{ "passing_buses"s,       passing_buses_size                                                                           },
+			{ "distances"s,           memory::GetNodeContainerBytes(distances_->stops_pair_to_distance)
+				+ memory::GetNodeContainerBytes(distances_->implied_pairs)                                                         }
+		};
+	}
+
+	std::vector<std::pair<StopPtr, double>> TransportCatalogue::Snapshot::GetNearestStops(geo::Coordinates point, size_t count) const {
+		std::vector<std::pair<StopPtr, double>> result;
+		for (const spatial::Neighbor& neighbor : stops_spatial_index_->FindNearest(point, count)) {
+			result.emplace_back(stops_->stops[neighbor.id], neighbor.distance);
+		}
+
+		return result;
+	}
+
+	std::vector<StopPtr> TransportCatalogue::Snapshot::GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+		std::vector<StopPtr> result;
+		for (const size_t id : stops_spatial_index_->FindInBox(min, max)) {
+			result.push_back(stops_->stops[id]);
+		}
+
+		return result;
+	}
+
+	TransportCatalogue::TransportCatalogue()
+		: names_(std::make_shared<strings::StringPool>())
+	{
+		auto snapshot = std::make_shared<Snapshot>();
+		snapshot->names_               = names_;
+		snapshot->stops_               = std::make_shared<const StopsIndex>();
+		snapshot->stops_spatial_index_ = std::make_shared<const spatial::PointIndex>();
+		snapshot->buses_               = std::make_shared<const BusesIndex>();
+		snapshot->distances_           = std::make_shared<const DistancesIndex>();
+		snapshot_ = std::move(snapshot);
+		published_.Store(snapshot_);
+	}
+
 	void TransportCatalogue::AddBus(Bus&& bus) {
-		buses_.push_back(std::make_shared<Bus>(std::move(bus)));
-		const auto bus_ptr = buses_.back().get();
-		name_to_bus_[*bus_ptr->name.get()] = buses_.back();
+		bus.name = names_->Intern(bus.name);
+		BusesIndex& buses = StageBuses();
+		buses.Thaw();
+		buses.buses.push_back(std::make_shared<Bus>(std::move(bus)));
+		const auto bus_ptr = buses.buses.back().get();
+		buses.name_to_bus[bus_ptr->name] = buses.buses.back();
 
-		AddToStopPassingBuses(bus_ptr->route, *bus_ptr->name.get());
+		AddToStopPassingBuses(bus_ptr->route, buses.buses.back());
 	}
 
 	void TransportCatalogue::AddStop(Stop&& stop) {
-		if (name_to_stop_.count(*stop.name.get())) {
+		if (GetStops().Find(stop.name)) {
 			return;
 		}
-		stops_.push_back(std::make_shared<Stop>(std::move(stop)));
-		const auto stop_ptr = stops_.back().get();
-		name_to_stop_[*stop_ptr->name.get()] = stops_.back();
+		stop.name = names_->Intern(stop.name);
+		StopsIndex& stops = StageStops();
+		stops.Thaw();
+		stops.stops.push_back(std::make_shared<Stop>(std::move(stop)));
+		const auto stop_ptr = stops.stops.back().get();
+		stops.name_to_stop[stop_ptr->name] = stops.stops.back();
+
+		StageDistances().stops_pair_to_distance[{ stops.stops.back(), stops.stops.back() }] = 0;
+	}
 
-		stops_pair_to_distance_[{ stops_.back(), stops_.back() }] = 0;
+	void TransportCatalogue::AddStops(std::vector<Stop>&& stops) {
+		StageStops().name_to_stop.reserve(GetStops().stops.size() + stops.size());
+		auto& stops_pair_to_distance = StageDistances().stops_pair_to_distance;
+		stops_pair_to_distance.reserve(stops_pair_to_distance.size() + stops.size());
+		for (Stop& stop : stops) {
+			AddStop(std::move(stop));
+		}
 	}
 
 	void TransportCatalogue::SetDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance) {
+		SetDistanceBetweenStops(SearchStop(first), SearchStop(second), distance);
+	}
+
+	void TransportCatalogue::SetDistancesBetweenStops(const std::vector<RoadDistance>& distances) {
+		DistancesIndex& staged = StageDistances();
+		// Most of the distances are set in both directions
+		staged.stops_pair_to_distance.reserve(staged.stops_pair_to_distance.size() + distances.size() * 2);
+		staged.implied_pairs.reserve(staged.implied_pairs.size() + distances.size());
+		for (const RoadDistance& road_distance : distances) {
+			SetDistanceBetweenStops(road_distance.from, road_distance.to, road_distance.distance);
+		}
+	}
+
+	void TransportCatalogue::SetDistanceBetweenStops(StopPtr stop_X, StopPtr stop_To, int distance) {
+		SetDistance(StageDistances(), stop_X, stop_To, distance);
+	}
+
+	std::vector<BusPtr> TransportCatalogue::UpdateDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance) {
 		StopPtr stop_X = SearchStop(first);
 		StopPtr stop_To = SearchStop(second);
+		if (stop_X == nullptr || stop_To == nullptr) {
+			return {};
+		}
+		const bool is_reverse_changed = SetDistance(StageDistances(), stop_X, stop_To, distance);
+
+		std::vector<BusPtr> result;
+		const auto* passing_buses = GetPassingBusesByStop(stop_X);
+		if (passing_buses == nullptr) {
+			return result;
+		}
+		for (const BusPtr& bus : *passing_buses) {
+			const auto& route = bus->route;
+			for (size_t i = 1; i < route.size(); ++i) {
+				if ((route[i - 1] == stop_X && route[i] == stop_To)
+					|| (is_reverse_changed && route[i - 1] == stop_To && route[i] == stop_X)) {
+					result.push_back(bus);
+					break;
+				}
+			}
+		}
+		if (result.empty()) {
+			return result;
+		}
+
+		// Published snapshots may hold the buses, so the changed ones are replaced by copies
+		BusesIndex& buses = StageBuses();
+		for (BusPtr& bus : result) {
+			auto new_bus = std::make_shared<Bus>(*bus);
+			new_bus->route_actual_length = ComputeRouteActualLength(new_bus->route);
+
+			// The position is kept, so a name directory stays valid
+			*std::find(buses.buses.begin(), buses.buses.end(), bus) = new_bus;
+			if (!buses.name_directory) {
+				// Another bus may have the name
+				const auto it = buses.name_to_bus.find(new_bus->name);
+				if (it != buses.name_to_bus.end() && it->second == bus) {
+					it->second = new_bus;
+				}
+			}
+			for (const StopPtr& stop : new_bus->route) {
+				auto& stop_buses = buses.stop_to_passing_buses[stop];
+				stop_buses.erase(bus);
+				stop_buses.insert(new_bus);
+			}
+			bus = std::move(new_bus);
+		}
+
+		return result;
+	}
 
-		stops_pair_to_distance_[{stop_X, stop_To}] = distance;
-		StopsPair tmp_pair = { stop_To, stop_X };
+	void TransportCatalogue::Finalize() {
+		StageStops().Finalize();
+		StageBuses().Finalize();
+	}
 
-		if (stops_pair_to_distance_.count(tmp_pair) == 0) {
-			stops_pair_to_distance_[move(tmp_pair)] = distance;
+	void TransportCatalogue::Commit() {
+		auto snapshot = std::make_shared<Snapshot>(*snapshot_);
+		if (staged_stops_) {
+			// Ids in the spatial index are the positions of the stops
+			std::vector<geo::Coordinates> points;
+			points.reserve(staged_stops_->stops.size());
+			for (const auto& stop : staged_stops_->stops) {
+				points.push_back({ stop->latitude, stop->longitude });
+			}
+			snapshot->stops_spatial_index_ = std::make_shared<const spatial::PointIndex>(points);
+			snapshot->stops_ = std::move(staged_stops_);
+		}
+		if (staged_buses_) {
+			staged_buses_->UpdateStats();
+			snapshot->buses_ = std::move(staged_buses_);
 		}
+		if (staged_distances_) {
+			snapshot->distances_ = std::move(staged_distances_);
+		}
+		staged_stops_.reset();
+		staged_buses_.reset();
+		staged_distances_.reset();
+		snapshot->names_memory_usage_ = names_->GetMemoryUsage();
+
+		// The old snapshot is freed by the last reader that still holds it
+		snapshot_ = std::move(snapshot);
+		published_.Store(snapshot_);
+	}
+
+	TransportCatalogue::SnapshotPtr TransportCatalogue::GetSnapshot() const {
+		return published_.Load();
 	}
 
 	BusPtr TransportCatalogue::SearchBus(const std::string_view name) const {
-		return (name_to_bus_.count(name) ? name_to_bus_.at(name) : nullptr);
+		return GetBuses().Find(name);
 	}
 
 	StopPtr TransportCatalogue::SearchStop(const std::string_view name) const {
-		return (name_to_stop_.count(name) ? name_to_stop_.at(name) : nullptr);
+		return GetStops().Find(name);
 	}
 
 	std::optional<int> TransportCatalogue::GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const {
-		StopPtr first_stop	= SearchStop(stop1_name);
-		StopPtr second_stop = SearchStop(stop2_name);
-		if (first_stop.get() == nullptr || second_stop.get() == nullptr) {
-			return {};
-		}
-		const StopsPair tmp_pair = { first_stop, second_stop };
+		return GetDistances().Find(SearchStop(stop1_name), SearchStop(stop2_name));
+	}
 
-		return (stops_pair_to_distance_.count(tmp_pair) ? stops_pair_to_distance_.at(tmp_pair) : std::optional<int>{});
+	std::optional<int> TransportCatalogue::GetActualDistanceBetweenStops(StopPtr first, StopPtr second) const {
+		return GetDistances().Find(first, second);
 	}
 
 	std::optional<double> TransportCatalogue::GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const {
@@ -77,21 +418,86 @@ namespace transport {
 	}
 
 	const std::unordered_set<BusPtr>* TransportCatalogue::GetPassingBusesByStop(StopPtr stop) const {
-		return ((stop_to_passing_buses_.count(stop)) ? &stop_to_passing_buses_.at(stop) : nullptr);
+		return GetBuses().FindPassingBuses(stop);
 	}
 
 	const std::vector<BusPtr> TransportCatalogue::GetBusesInVector() const {
-		return std::vector<BusPtr>(buses_.begin(), buses_.end());
+		const auto& buses = GetBuses().buses;
+		return std::vector<BusPtr>(buses.begin(), buses.end());
 	}
 
 	const std::vector<StopPtr> TransportCatalogue::GetStopsInVector() const {
-		return std::vector<StopPtr>(stops_.begin(), stops_.end());
+		const auto& stops = GetStops().stops;
+		return std::vector<StopPtr>(stops.begin(), stops.end());
+	}
+
+	const TransportCatalogue::StopsIndex& TransportCatalogue::GetStops() const {
+		return staged_stops_ ? *staged_stops_ : *snapshot_->stops_;
+	}
+
+	const TransportCatalogue::BusesIndex& TransportCatalogue::GetBuses() const {
+		return staged_buses_ ? *staged_buses_ : *snapshot_->buses_;
+	}
+
+	const TransportCatalogue::DistancesIndex& TransportCatalogue::GetDistances() const {
+		return staged_distances_ ? *staged_distances_ : *snapshot_->distances_;
+	}
+
+	TransportCatalogue::StopsIndex& TransportCatalogue::StageStops() {
+		if (!staged_stops_) {
+			staged_stops_ = std::make_shared<StopsIndex>(*snapshot_->stops_);
+		}
+		return *staged_stops_;
+	}
+
+	TransportCatalogue::BusesIndex& TransportCatalogue::StageBuses() {
+		if (!staged_buses_) {
+			staged_buses_ = std::make_shared<BusesIndex>(*snapshot_->buses_);
+		}
+		return *staged_buses_;
 	}
 
-	void TransportCatalogue::AddToStopPassingBuses(const std::vector<StopPtr>& stops, const std::string_view bus_name) {
-		BusPtr bus = SearchBus(bus_name);
+	TransportCatalogue::DistancesIndex& TransportCatalogue::StageDistances() {
+		if (!staged_distances_) {
+			staged_distances_ = std::make_shared<DistancesIndex>(*snapshot_->distances_);
+		}
+		return *staged_distances_;
+	}
+
+	void TransportCatalogue::AddToStopPassingBuses(const std::vector<StopPtr>& stops, BusPtr bus) {
+		auto& stop_to_passing_buses = StageBuses().stop_to_passing_buses;
 		for (size_t i = 0; i < stops.size(); ++i) {
-			stop_to_passing_buses_[stops[i]].insert(bus);
+			stop_to_passing_buses[stops[i]].insert(bus);
+		}
+	}
+
+	bool TransportCatalogue::SetDistance(DistancesIndex& distances, StopPtr stop_X, StopPtr stop_To, int distance) {
+		distances.stops_pair_to_distance[{ stop_X, stop_To }] = distance;
+		distances.implied_pairs.erase({ stop_X, stop_To });
+		if (stop_X == stop_To) {
+			return false;
+		}
+
+		// The reverse direction defaults to the same distance unless it is set
+		const auto [it, is_inserted] = distances.stops_pair_to_distance.emplace(StopsPair{ stop_To, stop_X }, distance);
+		if (is_inserted) {
+			distances.implied_pairs.insert(it->first);
+			return true;
+		}
+		if (distances.implied_pairs.count(it->first)) {
+			const bool is_changed = it->second != distance;
+			it->second = distance;
+			return is_changed;
 		}
+		return false;
+	}
+
+	int TransportCatalogue::ComputeRouteActualLength(const std::vector<StopPtr>& route) const {
+		int result = 0;
+		for (size_t i = 1; i < route.size(); ++i) {
+			result += GetDistances().Find(route[i - 1], route[i]).value_or(0);
+		}
+
+		return result;
 	}
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "domain.h"
+#include "flat_hash_map.h"
+#include "geo.h"
+#include "memory_usage.h"
+#include "parallel.h"
+#include "perfect_hash.h"
+#include "spatial_index.h"
+#include "string_pool.h"
 
 #include <string>
 #include <vector>
@@ -26,30 +33,131 @@ namespace transport {
 			std::hash<const void*> hash_;
 		};
 
+		// Names are looked up in name_to_stop, or in name_directory once the index is finalized if they are unique
+		struct StopsIndex {
+			domain::StopPtr Find(const std::string_view name) const;
+			void            Finalize();
+			void            Thaw();
+
+			std::deque<std::shared_ptr<domain::Stop>>                  stops;
+			containers::FlatHashMap<std::string_view, domain::StopPtr> name_to_stop;
+			std::shared_ptr<const containers::MinimalPerfectHash>      name_directory;
+		};
+
+		struct BusesIndex {
+			domain::BusPtr                            Find(const std::string_view name)       const;
+			std::optional<domain::BusStat>            FindStat(const std::string_view name)   const;
+			const std::unordered_set<domain::BusPtr>* FindPassingBuses(domain::StopPtr stop) const;
+			void                                      Finalize();
+			void                                      Thaw();
+			void                                      UpdateStats();
+
+			std::deque<std::shared_ptr<domain::Bus>>                                     buses;
+			containers::FlatHashMap<std::string_view, domain::BusPtr>                    name_to_bus;
+			std::shared_ptr<const containers::MinimalPerfectHash>                        name_directory;
+			containers::FlatHashMap<domain::StopPtr, std::unordered_set<domain::BusPtr>> stop_to_passing_buses;
+			// stats[i] is of buses[i], read through the name directory. Filled at Commit, empty without the directory.
+			std::vector<domain::BusStat>                                                 stats;
+		};
+
+		struct DistancesIndex {
+			std::optional<int> Find(domain::StopPtr first, domain::StopPtr second) const;
+
+			std::unordered_map<StopsPair, int, StopsPairHasher> stops_pair_to_distance;
+			// The pairs whose distance was not set but taken from the reverse direction, they follow its changes
+			std::unordered_set<StopsPair, StopsPairHasher>      implied_pairs;
+		};
+
 	public:
+		// Immutable state of the catalogue, it may be read from any thread as long as it is held
+		class Snapshot {
+		public:
+			domain::BusPtr  SearchBus(const std::string_view name)  const;
+			domain::StopPtr SearchStop(const std::string_view name) const;
+			// Precomputed once the catalogue is finalized
+			std::optional<domain::BusStat> GetBusStat(const std::string_view name) const;
+
+			std::optional<int>                        GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name)       const;
+			std::optional<double>                     GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name)   const;
+			const std::unordered_set<domain::BusPtr>* GetPassingBusesByStop(domain::StopPtr stop)                                                               const;
+			const std::vector<domain::BusPtr>         GetBusesInVector()                                                                                        const;
+			const std::vector<domain::StopPtr>        GetStopsInVector()                                                                                        const;
+			size_t                                    GetBusCount()                                                                                             const;
+			size_t                                    GetStopCount()                                                                                            const;
+			memory::Report                            GetMemoryReport()                                                                                         const;
+
+			// Sorted by the distance to the point in meters
+			std::vector<std::pair<domain::StopPtr, double>> GetNearestStops(geo::Coordinates point, size_t count)  const;
+			std::vector<domain::StopPtr>                    GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
+
+		private:
+			friend class TransportCatalogue;
+
+			// Owns the names the indexes refer to, shared by all the snapshots
+			std::shared_ptr<const strings::StringPool> names_;
+			std::shared_ptr<const StopsIndex>          stops_;
+			std::shared_ptr<const spatial::PointIndex> stops_spatial_index_;
+			std::shared_ptr<const BusesIndex>          buses_;
+			std::shared_ptr<const DistancesIndex>      distances_;
+			// The pool grows with the later versions, its size is taken when the snapshot is committed
+			size_t                                     names_memory_usage_ = 0;
+		};
+		using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+		TransportCatalogue();
+
+		// Changes are staged by the single writer and become visible to GetSnapshot after Commit.
+		// Only the indexes a change touches are copied.
 		void AddBus(domain::Bus&& bus);
 		void AddStop(domain::Stop&& stop);
+		// Same as adding one by one in order, with the indexes sized once
+		void AddStops(std::vector<domain::Stop>&& stops);
 		void SetDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance);
+		void SetDistancesBetweenStops(const std::vector<domain::RoadDistance>& distances);
+		// Also recomputes the actual length of the buses driving between the stops and returns them. The reverse
+		// distance changes too if it was not set, so the buses driving back are among them.
+		std::vector<domain::BusPtr> UpdateDistanceBetweenStops(const std::string_view first, const std::string_view second, int distance);
+		// Replaces the name maps with minimal perfect hashes once the names are loaded,
+		// adding a stop or a bus later brings the maps back
+		void Finalize();
+		void Commit();
 
+		// Takes no locks, may be called from any thread
+		SnapshotPtr GetSnapshot() const;
+
+		// The writer's view: the last committed state with the staged changes
 		domain::BusPtr  SearchBus(const std::string_view name)  const;
 		domain::StopPtr SearchStop(const std::string_view name) const;
 
 		std::optional<int>                        GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name)       const;
+		std::optional<int>                        GetActualDistanceBetweenStops(domain::StopPtr first, domain::StopPtr second)                              const;
 		std::optional<double>                     GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name)   const;
 		const std::unordered_set<domain::BusPtr>* GetPassingBusesByStop(domain::StopPtr stop)                                                               const;
 		const std::vector<domain::BusPtr>         GetBusesInVector()                                                                                        const;
 		const std::vector<domain::StopPtr>        GetStopsInVector()                                                                                        const;
 
 	private:
-		std::deque<std::shared_ptr<domain::Stop>> stops_;
-		std::deque<std::shared_ptr<domain::Bus>>  buses_;
+		// The last committed snapshot as the writer reads it, and as it is published to the readers
+		SnapshotPtr                            snapshot_;
+		parallel::PublishedPtr<const Snapshot> published_;
+
+		std::shared_ptr<strings::StringPool> names_;
 
-		std::unordered_map<std::string_view, domain::BusPtr, std::hash<std::string_view>>  name_to_bus_;
-		std::unordered_map<std::string_view, domain::StopPtr, std::hash<std::string_view>> name_to_stop_;
+		std::shared_ptr<StopsIndex>     staged_stops_;
+		std::shared_ptr<BusesIndex>     staged_buses_;
+		std::shared_ptr<DistancesIndex> staged_distances_;
 
-		std::unordered_map<StopsPair, int, StopsPairHasher>                                                 stops_pair_to_distance_;
-		std::unordered_map<domain::StopPtr, std::unordered_set<domain::BusPtr>, std::hash<domain::StopPtr>> stop_to_passing_buses_;
+		const StopsIndex&     GetStops()     const;
+		const BusesIndex&     GetBuses()     const;
+		const DistancesIndex& GetDistances() const;
+		StopsIndex&           StageStops();
+		BusesIndex&           StageBuses();
+		DistancesIndex&       StageDistances();
 
-		void AddToStopPassingBuses(const std::vector<domain::StopPtr>& stops, const std::string_view bus_name);
+		void AddToStopPassingBuses(const std::vector<domain::StopPtr>& stops, domain::BusPtr bus);
+		void SetDistanceBetweenStops(domain::StopPtr first, domain::StopPtr second, int distance);
+		// Returns whether the implied reverse distance has changed
+		static bool SetDistance(DistancesIndex& distances, domain::StopPtr stop_X, domain::StopPtr stop_To, int distance);
+		int  ComputeRouteActualLength(const std::vector<domain::StopPtr>& route) const;
 	};
-}
\ No newline at end of file
+}
@@ -1,20 +1,96 @@
 #include "transport_router.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <new>
+#include <tuple>
 
 namespace transport {
 
-    Router::Router(const size_t graph_size)
-		: graph_(graph_size)
+	using namespace std::literals;
+
+	namespace {
+
+		// Measured on the generated cities: a relaxation of a table cell, a step of Dijkstra, reading a route
+		constexpr double TABLE_RELAXATION_SECONDS = 0.5e-9;
+		constexpr double SEARCH_STEP_SECONDS      = 20e-9;
+		constexpr double TABLE_QUERY_SECONDS      = 1e-6;
+
+		graph::DirectedWeightedGraph<double> MakeGraph(size_t vertex_count, const std::vector<EdgeInfo>& edges) {
+			std::vector<graph::Edge<double>> graph_edges;
+			graph_edges.reserve(edges.size());
+			for (const auto& edge_info : edges) {
+				graph_edges.push_back(edge_info.edge);
+			}
+
+			return graph::DirectedWeightedGraph<double>(vertex_count, std::move(graph_edges));
+		}
+	}
+
+	std::string_view BackendToString(RouterBackend backend) {
+		switch (backend) {
+		case RouterBackend::ROUTES_TABLE:
+			return "routes table"sv;
+		case RouterBackend::PER_QUERY_SEARCH:
+			return "per-query search"sv;
+		}
+		return {};
+	}
+
+	Router::RoutingState::RoutingState(Graph&& f_graph, std::vector<EdgeInfo>&& f_edges, StopToVertexes&& f_stop_to_vertex_id)
+		: graph(std::move(f_graph))
+		, edges(std::move(f_edges))
+		, stop_to_vertex_id(std::move(f_stop_to_vertex_id))
 	{}
 
 	void Router::SetSettings(const double bus_wait_time, const double bus_velocity) {
 		settings_ = { bus_wait_time, bus_velocity };
 	}
 
+	void Router::SetWalkingSettings(const double walking_velocity, const size_t walking_stop_count) {
+		settings_.walking_velocity   = walking_velocity;
+		settings_.walking_stop_count = walking_stop_count;
+	}
+
+	void Router::SetMemoryBudget(const size_t memory_budget) {
+		memory_budget_ = memory_budget;
+	}
+
+	void Router::SetExpectedQueryCount(const size_t query_count) {
+		expected_query_count_ = query_count;
+	}
+
+	std::vector<RouterBackendEstimate> Router::EstimateBackends(size_t vertex_count, size_t edge_count) {
+		const double vertexes = static_cast<double>(vertex_count);
+		const double search_steps = static_cast<double>(edge_count) + vertexes * std::log2(std::max(vertexes, 2.));
+		// A search holds a weight, a previous edge and a settled flag per vertex
+		const size_t search_memory = vertex_count * (sizeof(std::optional<double>) + sizeof(std::optional<graph::EdgeId>) + 1);
+
+		return {
+			{
+				RouterBackend::ROUTES_TABLE,
+				vertex_count * vertex_count * RouterG::GetTableCellSize(),
+				vertexes * vertexes * vertexes * TABLE_RELAXATION_SECONDS,
+				TABLE_QUERY_SECONDS
+			},
+			{
+				RouterBackend::PER_QUERY_SEARCH,
+				search_memory,
+				0.,
+				search_steps * SEARCH_STEP_SECONDS
+			}
+		};
+	}
+
 	void Router::AddWaitEdge(const std::string_view stop_name) {
+		const Vertexes& vertexes = stop_to_vertex_id_[stop_name];
 		EdgeInfo new_edge{
 			{
-				stop_to_vertex_id_[stop_name].start_wait,
-				stop_to_vertex_id_[stop_name].end_wait,
+				vertexes.start_wait,
+				vertexes.end_wait,
 				settings_.wait_time
 			},
 			stop_name,
@@ -22,70 +98,493 @@ namespace transport {
 			settings_.wait_time
 		};
 		edges_.push_back(std::move(new_edge));
+		is_edge_removed_.push_back(false);
 	}
 
 	void Router::AddBusEdge(const std::string_view stop_from, const std::string_view stop_to, const std::string_view bus_name, const int span_count, const int dist) {
-		EdgeInfo new_edge{
-			{
-				stop_to_vertex_id_[stop_from].end_wait,
-				stop_to_vertex_id_[stop_to].start_wait,
-				dist / settings_.velocity * TO_MINUTES
-			},
-			bus_name,
-			span_count,
-			dist / settings_.velocity * TO_MINUTES
-		};
+		EdgeInfo new_edge = MakeBusEdge(stop_to_vertex_id_[stop_from], stop_to_vertex_id_[stop_to], bus_name, span_count, dist);
+		if (TryRestoreBusEdge(new_edge)) {
+			return;
+		}
+		bus_to_edges_[bus_name].push_back(edges_.size());
 		edges_.push_back(std::move(new_edge));
+		is_edge_removed_.push_back(false);
+	}
+
+	void Router::AddBusRoutes(const std::vector<BusRoute>& routes) {
+		// Removed edges may be restored one by one only
+		if (!bus_to_removed_edges_.empty()) {
+			for (const BusRoute& route : routes) {
+				for (size_t i = 0; i + 1 < route.stops.size(); ++i) {
+					int dist = 0;
+					for (size_t j = i + 1; j < route.stops.size(); ++j) {
+						dist += route.distances[j - 1];
+						AddBusEdge(route.stops[i], route.stops[j], route.bus_name, static_cast<int>(j - i), dist);
+					}
+				}
+			}
+			return;
+		}
+
+		// Every route gets its own range of the edges, so the ranges are filled in parallel
+		std::vector<size_t> offsets(routes.size() + 1, edges_.size());
+		for (size_t r = 0; r < routes.size(); ++r) {
+			const size_t stop_count = routes[r].stops.size();
+			offsets[r + 1] = offsets[r] + (stop_count > 0 ? stop_count * (stop_count - 1) / 2 : 0);
+		}
+		edges_.resize(offsets.back());
+		is_edge_removed_.resize(offsets.back(), false);
+
+		parallel::ForEachIndex(routes.size(), [this, &routes, &offsets](size_t r) {
+			const BusRoute& route = routes[r];
+			std::vector<Vertexes> vertexes;
+			vertexes.reserve(route.stops.size());
+			for (const std::string_view stop_name : route.stops) {
+				vertexes.push_back(stop_to_vertex_id_.at(stop_name));
+			}
+
+			graph::EdgeId id = offsets[r];
+			for (size_t i = 0; i + 1 < vertexes.size(); ++i) {
+				int dist = 0;
+				for (size_t j = i + 1; j < vertexes.size(); ++j) {
+					dist += route.distances[j - 1];
+					edges_[id++] = MakeBusEdge(vertexes[i], vertexes[j], route.bus_name, static_cast<int>(j - i), dist);
+				}
+			}
+		});
+
+		for (size_t r = 0; r < routes.size(); ++r) {
+			auto& bus_edges = bus_to_edges_[routes[r].bus_name];
+			for (graph::EdgeId id = offsets[r]; id < offsets[r + 1]; ++id) {
+				bus_edges.push_back(id);
+			}
+		}
 	}
 
-	void Router::AddStop(const std::string_view stop_name) {
-		if (!stop_to_vertex_id_.count(stop_name)) {
-			size_t sz = stop_to_vertex_id_.size();
-			stop_to_vertex_id_[stop_name] = { sz * 2, sz * 2 + 1 };
+	void Router::AddStop(const std::string_view stop_name, geo::Coordinates coordinates) {
+		const size_t sz = stop_to_vertex_id_.size();
+		if (stop_to_vertex_id_.emplace(stop_name, { sz * 2, sz * 2 + 1 }).second) {
+			stop_names_.push_back(stop_name);
+			stop_coordinates_.push_back(coordinates);
 		}
 	}
 
-	void Router::BuildGraph() {
-		if (!graph_) {
-			graph_ = std::move(Graph(stop_to_vertex_id_.size() * 2));
+	void Router::RemoveBusEdges(const std::string_view bus_name) {
+		const auto it = bus_to_edges_.find(bus_name);
+		if (it == bus_to_edges_.end()) {
+			return;
+		}
+		auto& removed_edges = bus_to_removed_edges_[bus_name];
+		for (const graph::EdgeId id : it->second) {
+			if (!is_edge_removed_[id]) {
+				is_edge_removed_[id] = true;
+				removed_edges.push_back(id);
+			}
 		}
-		AddEdgesToGraph();
 	}
 
-	void Router::BuildRouter() {
-		if (!router_ && graph_) {
-			router_.emplace(RouterG(*graph_));
+	void Router::SetWaitTime(const double bus_wait_time) {
+		settings_.wait_time = bus_wait_time;
+		for (auto& edge_info : edges_) {
+			if (edge_info.span_count == -1) {
+				edge_info.edge.weight = bus_wait_time;
+				edge_info.time        = bus_wait_time;
+			}
 		}
 	}
 
-	std::optional<RouteInfo> Router::GetRouteInfo(const std::string_view from, const std::string_view to) const {
-		const auto route = router_->BuildRoute(
-			stop_to_vertex_id_.at(from).start_wait,
-			stop_to_vertex_id_.at(to).start_wait
-		);
+	void Router::Commit() {
+		const StatePtr prev_state = state_;
+
+		std::vector<EdgeInfo> edges;
+		edges.reserve(edges_.size());
+		graph::EdgesUpdate update;
+		update.new_edge_ids.resize(committed_edge_count_);
+		// The edges are renumbered without the removed ones
+		bus_to_edges_.clear();
+
+		for (graph::EdgeId id = 0; id < edges_.size(); ++id) {
+			if (is_edge_removed_[id]) {
+				continue;
+			}
+			const graph::EdgeId new_id = edges.size();
+			edges.push_back(edges_[id]);
+			if (edges_[id].span_count != -1) {
+				bus_to_edges_[edges_[id].name].push_back(new_id);
+			}
+			if (id >= committed_edge_count_) {
+				update.lighter_edges.push_back(new_id);
+				continue;
+			}
+			update.new_edge_ids[id] = new_id;
+			const double prev_weight = prev_state->edges[id].edge.weight;
+			if (prev_weight < edges_[id].edge.weight) {
+				update.heavier_edges.push_back(new_id);
+			} else if (edges_[id].edge.weight < prev_weight) {
+				update.lighter_edges.push_back(new_id);
+			}
+		}
+
+		edges_ = edges;
+		is_edge_removed_.assign(edges_.size(), false);
+		bus_to_removed_edges_.clear();
+		committed_edge_count_ = edges_.size();
+
+		const size_t vertex_count = stop_to_vertex_id_.size() * 2;
+		Graph graph = MakeGraph(vertex_count, edges);
+		auto stop_to_vertex_id = stop_to_vertex_id_;
+
+		const RouterBackend backend = ChooseBackend(vertex_count, edges.size());
+		auto state = std::make_shared<RoutingState>(std::move(graph), std::move(edges), std::move(stop_to_vertex_id));
+		// New stops change the table dimensions, so the table is built from scratch
+		const bool is_same_vertexes = prev_state && prev_state->graph.GetVertexCount() == vertex_count;
+		if (backend == RouterBackend::ROUTES_TABLE) {
+			BuildRoutesTable(*state, is_same_vertexes ? prev_state.get() : nullptr, update);
+		}
+		state->stops_index = is_same_vertexes
+			? prev_state->stops_index
+			: std::make_shared<const spatial::PointIndex>(stop_coordinates_);
+		state->stop_names          = stop_names_;
+		state->walking_velocity    = settings_.walking_velocity;
+		state->walking_stop_count  = settings_.walking_stop_count;
+		state->staged_memory_usage = GetStagedMemoryUsage();
+		state_ = std::move(state);
+		published_state_.Store(state_);
+	}
+
+	std::optional<RouteInfo> Router::GetRouteInfo(const StatePtr& state, const std::string_view from, const std::string_view to) const {
+		if (!state) {
+			return std::nullopt;
+		}
+		const auto from_vertex = FindStartWaitVertex(*state, from);
+		const auto to_vertex   = FindStartWaitVertex(*state, to);
+		if (!from_vertex || !to_vertex) {
+			return std::nullopt;
+		}
+		// The backends have their own route types
+		const auto make_route_info = [this, &state](const auto& route) -> std::optional<RouteInfo> {
+			if (!route) {
+				return std::nullopt;
+			}
+			return RouteInfo{
+				route->weight,
+				MakeItemsByEdgeIds(*state, route->edges)
+			};
+		};
+
+		return state->router
+			? make_route_info(state->router->BuildRoute(*from_vertex, *to_vertex))
+			: make_route_info(graph::ShortestPathTree<double>(state->graph, *from_vertex).BuildRoute(*to_vertex));
+	}
+
+	std::vector<std::optional<RouteInfo>> Router::GetRouteInfos(const StatePtr& state, const std::string_view from, const std::vector<std::string_view>& to) const {
+		std::vector<std::optional<RouteInfo>> result(to.size());
+		if (!state) {
+			return result;
+		}
+		const auto from_vertex = FindStartWaitVertex(*state, from);
+		if (!from_vertex) {
+			return result;
+		}
+		const auto fill_result = [this, &state, &to, &result](const auto& build_route) {
+			for (size_t i = 0; i < to.size(); ++i) {
+				const auto to_vertex = FindStartWaitVertex(*state, to[i]);
+				if (!to_vertex) {
+					continue;
+				}
+				if (const auto route = build_route(*to_vertex)) {
+					result[i] = RouteInfo{
+						route->weight,
+						MakeItemsByEdgeIds(*state, route->edges)
+					};
+				}
+			}
+		};
+
+		if (state->router) {
+			fill_result([&state, &from_vertex](size_t to_vertex) {
+				return state->router->BuildRoute(*from_vertex, to_vertex);
+			});
+		} else {
+			const graph::ShortestPathTree<double> tree(state->graph, *from_vertex);
+			fill_result([&tree](size_t to_vertex) {
+				return tree.BuildRoute(to_vertex);
+			});
+		}
+
+		return result;
+	}
+
+	std::optional<RouteInfo> Router::GetRouteInfo(const StatePtr& state, const RoutePoint& from, const RoutePoint& to) const {
+		const auto* from_stop = std::get_if<std::string_view>(&from);
+		const auto* to_stop   = std::get_if<std::string_view>(&to);
+		if (from_stop && to_stop) {
+			return GetRouteInfo(state, *from_stop, *to_stop);
+		}
+		if (!state) {
+			return std::nullopt;
+		}
+
+		graph::GraphOverlay<double> overlay(state->graph);
+		std::vector<RouteItemWalk> walk_items;
+		const auto add_walk_edge = [&state, &overlay, &walk_items](graph::VertexId from, graph::VertexId to, std::optional<std::string_view> stop_name, double distance) {
+			const double time = ComputeWalkingTime(*state, distance);
+			overlay.AddEdge({ from, to, time });
+			walk_items.push_back({ stop_name, distance, time });
+		};
+		const auto find_nearest = [&state](geo::Coordinates point) {
+			return state->stops_index->FindNearest(point, state->walking_stop_count);
+		};
+
+		std::optional<graph::VertexId> from_vertex;
+		if (from_stop) {
+			from_vertex = FindStartWaitVertex(*state, *from_stop);
+		} else {
+			from_vertex = overlay.AddVertex();
+			for (const spatial::Neighbor& neighbor : find_nearest(std::get<geo::Coordinates>(from))) {
+				add_walk_edge(*from_vertex, neighbor.id * 2, state->stop_names[neighbor.id], neighbor.distance);
+			}
+		}
+		std::optional<graph::VertexId> to_vertex;
+		if (to_stop) {
+			to_vertex = FindStartWaitVertex(*state, *to_stop);
+		} else {
+			to_vertex = overlay.AddVertex();
+			for (const spatial::Neighbor& neighbor : find_nearest(std::get<geo::Coordinates>(to))) {
+				add_walk_edge(neighbor.id * 2, *to_vertex, state->stop_names[neighbor.id], neighbor.distance);
+			}
+		}
+		if (!from_vertex || !to_vertex) {
+			return std::nullopt;
+		}
+		if (!from_stop && !to_stop) {
+			const double distance = geo::ComputeDistance(std::get<geo::Coordinates>(from), std::get<geo::Coordinates>(to));
+			add_walk_edge(*from_vertex, *to_vertex, std::nullopt, distance);
+		}
+
+		const graph::ShortestPathTree<double, graph::GraphOverlay<double>> tree(overlay, *from_vertex);
+		const auto route = tree.BuildRoute(*to_vertex);
 		if (!route) {
 			return std::nullopt;
 		}
 
 		return RouteInfo{
 			route->weight,
-			MakeItemsByEdgeIds(route->edges)
+			MakeItemsByEdgeIds(*state, route->edges, walk_items)
 		};
 	}
 
-	void Router::AddEdgesToGraph() {
-		for (auto& edge_info : edges_) {
-			graph_->AddEdge(edge_info.edge);
+	TimeMatrix Router::GetTotalTimes(const StatePtr& state, const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const {
+		TimeMatrix result(from.size(), std::vector<std::optional<double>>(to.size()));
+		if (!state) {
+			return result;
+		}
+
+		std::vector<std::optional<size_t>> to_vertexes;
+		to_vertexes.reserve(to.size());
+		for (const std::string_view stop_name : to) {
+			to_vertexes.push_back(FindStartWaitVertex(*state, stop_name));
+		}
+
+		parallel::ForEachIndex(from.size(), [this, &state, &from, &to_vertexes, &result](size_t i) {
+			const auto from_vertex = FindStartWaitVertex(*state, from[i]);
+			if (!from_vertex) {
+				return;
+			}
+			const auto weights = state->router
+				? state->router->BuildWeightsFrom(*from_vertex)
+				: graph::ShortestPathTree<double>(state->graph, *from_vertex).GetWeights();
+			for (size_t j = 0; j < to_vertexes.size(); ++j) {
+				if (to_vertexes[j]) {
+					result[i][j] = weights[*to_vertexes[j]];
+				}
+			}
+		});
+
+		return result;
+	}
+
+	std::optional<std::vector<ReachableStop>> Router::GetReachableStops(const StatePtr& state, const std::string_view from, const double max_time) const {
+		if (!state) {
+			return std::nullopt;
+		}
+		const auto from_vertex = FindStartWaitVertex(*state, from);
+		if (!from_vertex) {
+			return std::nullopt;
 		}
+		const graph::ShortestPathTree<double> tree(state->graph, *from_vertex, max_time);
+
+		std::vector<ReachableStop> result;
+		for (const auto& [stop_name, vertexes] : state->stop_to_vertex_id) {
+			if (const auto time = tree.GetWeight(vertexes.start_wait)) {
+				result.push_back({ stop_name, *time });
+			}
+		}
+		std::sort(result.begin(), result.end(),
+			[](const ReachableStop& lhs, const ReachableStop& rhs) {
+				return std::tie(lhs.time, lhs.stop_name) < std::tie(rhs.time, rhs.stop_name);
+			}
+		);
+
+		return result;
+	}
+
+	size_t Router::GetVertexCount() const {
+		const auto state = GetState();
+		return state ? state->graph.GetVertexCount() : 0;
 	}
 
-	std::vector<RouteItem> Router::MakeItemsByEdgeIds(const std::vector<graph::EdgeId>& edge_ids) const {
+	size_t Router::GetEdgeCount() const {
+		const auto state = GetState();
+		return state ? state->graph.GetEdgeCount() : 0;
+	}
+
+	memory::Report Router::GetMemoryReport(const StatePtr& state) const {
+		if (!state) {
+			return {};
+		}
+		return {
+			{ "graph_edges"s,           state->graph.GetEdgesMemoryUsage()                                            },
+			{ "graph_incidence_lists"s, state->graph.GetIncidenceListsMemoryUsage()                                   },
+			{ "edge_infos"s,            memory::GetVectorBytes(state->edges)                                          },
+			{ "stop_vertexes"s,         state->stop_to_vertex_id.GetMemoryUsage() + memory::GetVectorBytes(state->stop_names) },
+			{ "stops_spatial_index"s,   state->stops_index ? state->stops_index->GetMemoryUsage() : 0                 },
+			{ "routes_table"s,          state->router ? state->router->GetMemoryUsage() : 0                           },
+			{ "staged"s,                state->staged_memory_usage                                                    }
+		};
+	}
+
+	std::optional<RouterBackend> Router::GetBackend() const {
+		const auto state = GetState();
+		if (!state) {
+			return std::nullopt;
+		}
+		return state->router ? RouterBackend::ROUTES_TABLE : RouterBackend::PER_QUERY_SEARCH;
+	}
+
+	Router::StatePtr Router::GetState() const {
+		return published_state_.Load();
+	}
+
+	RouterBackend Router::ChooseBackend(size_t vertex_count, size_t edge_count) const {
+		size_t budget = DEFAULT_MEMORY_BUDGET;
+		if (memory_budget_) {
+			budget = *memory_budget_;
+		} else if (const size_t physical_kb = profile::GetPhysicalMemoryKb(); physical_kb > 0) {
+			budget = physical_kb / 2 * 1024;
+		}
+
+		const std::vector<RouterBackendEstimate> estimates = EstimateBackends(vertex_count, edge_count);
+		const auto get_seconds = [this](const RouterBackendEstimate& estimate) {
+			return expected_query_count_
+				? estimate.build_seconds + *expected_query_count_ * estimate.query_seconds
+				: estimate.query_seconds;
+		};
+		const auto is_faster = [&get_seconds](const RouterBackendEstimate& lhs, const RouterBackendEstimate& rhs) {
+			return get_seconds(lhs) < get_seconds(rhs);
+		};
+		const RouterBackendEstimate& fastest = *std::min_element(estimates.begin(), estimates.end(), is_faster);
+
+		// The fastest that fits, or the smallest if none does
+		const RouterBackendEstimate* chosen = nullptr;
+		for (const RouterBackendEstimate& estimate : estimates) {
+			if (estimate.memory_bytes <= budget && (!chosen || is_faster(estimate, *chosen))) {
+				chosen = &estimate;
+			}
+		}
+		if (!chosen) {
+			chosen = &*std::min_element(estimates.begin(), estimates.end(),
+				[](const RouterBackendEstimate& lhs, const RouterBackendEstimate& rhs) {
+					return lhs.memory_bytes < rhs.memory_bytes;
+				}
+			);
+		}
+
+		// A backend slower than the fastest is always logged, the choice is logged otherwise when profiling.
+		// Logged once, and again only when the choice changes.
+		const bool is_fallback = chosen->backend != fastest.backend;
+		if (GetBackend() != chosen->backend && (is_fallback || profile::Profiler::FromEnvironment().IsEnabled())) {
+			std::clog << "Router backend: "s << BackendToString(chosen->backend)
+				<< " for "s << vertex_count << " vertexes and "s << edge_count << " edges, "s
+				<< (chosen->memory_bytes >> 20) << " MiB of "s << (budget >> 20) << " MiB budget, "s
+				<< "build up to ~"s << chosen->build_seconds << " s, query ~"s << chosen->query_seconds * 1e6 << " us"s;
+			if (is_fallback) {
+				std::clog << ", "s << BackendToString(fastest.backend) << " needs "s << (fastest.memory_bytes >> 20) << " MiB"s;
+			}
+			std::clog << std::endl;
+		}
+
+		return chosen->backend;
+	}
+
+	void Router::BuildRoutesTable(RoutingState& state, const RoutingState* prev_state, const graph::EdgesUpdate& update) const {
+		try {
+			if (prev_state && prev_state->router) {
+				state.router.emplace(state.graph, *prev_state->router, update);
+			} else {
+				state.router.emplace(state.graph);
+			}
+		} catch (const std::bad_alloc&) {
+			// A throwing emplace leaves the optional empty
+			std::clog << "Router backend: the routes table can't be allocated, falling back to "s
+				<< BackendToString(RouterBackend::PER_QUERY_SEARCH) << std::endl;
+		}
+	}
+
+	bool Router::TryRestoreBusEdge(const EdgeInfo& edge_info) {
+		// A bus re-added after RemoveBusEdges gets the same edges back, keeping their ids
+		// lets Commit treat them as changed weights instead of new edges
+		const auto it = bus_to_removed_edges_.find(edge_info.name);
+		if (it == bus_to_removed_edges_.end() || it->second.empty()) {
+			return false;
+		}
+		const graph::EdgeId id = it->second.front();
+		EdgeInfo& removed_edge = edges_[id];
+		if (removed_edge.edge.from != edge_info.edge.from || removed_edge.edge.to != edge_info.edge.to || removed_edge.span_count != edge_info.span_count) {
+			return false;
+		}
+		removed_edge = edge_info;
+		is_edge_removed_[id] = false;
+		it->second.pop_front();
+
+		return true;
+	}
+
+	EdgeInfo Router::MakeBusEdge(const Vertexes& from, const Vertexes& to, const std::string_view bus_name, const int span_count, const int dist) const {
+		return {
+			{
+				from.end_wait,
+				to.start_wait,
+				dist / settings_.velocity * TO_MINUTES
+			},
+			bus_name,
+			span_count,
+			dist / settings_.velocity * TO_MINUTES
+		};
+	}
+
+	std::optional<size_t> Router::FindStartWaitVertex(const RoutingState& state, const std::string_view stop_name) const {
+		const auto it = state.stop_to_vertex_id.find(stop_name);
+		if (it == state.stop_to_vertex_id.end()) {
+			return std::nullopt;
+		}
+
+		return it->second.start_wait;
+	}
+
+	std::vector<RouteItem> Router::MakeItemsByEdgeIds(const RoutingState& state, const std::vector<graph::EdgeId>& edge_ids,
+		const std::vector<RouteItemWalk>& walk_items) const {
 		std::vector<RouteItem> result;
 		result.reserve(edge_ids.size());
 
 		for (const auto id : edge_ids) {
-			const EdgeInfo& edge_info = edges_[id];
 			RouteItem tmp;
+			if (id >= state.edges.size()) {
+				tmp.walk_item = walk_items[id - state.edges.size()];
+				result.push_back(std::move(tmp));
+				continue;
+			}
+			const EdgeInfo& edge_info = state.edges[id];
 			if (edge_info.span_count == -1) {
 				tmp.wait_item = {
 					edge_info.name,
@@ -103,4 +602,26 @@ namespace transport {
 
 		return result;
 	}
+
+	double Router::ComputeWalkingTime(const RoutingState& state, double distance) {
+		return distance / state.walking_velocity * TO_MINUTES;
+	}
+
+	size_t Router::GetStagedMemoryUsage() const {
+		size_t result = stop_to_vertex_id_.GetMemoryUsage()
+			+ memory::GetVectorBytes(stop_names_)
+			+ memory::GetVectorBytes(stop_coordinates_)
+			+ memory::GetVectorBytes(edges_)
+			+ memory::GetVectorBytes(is_edge_removed_)
+			+ memory::GetNodeContainerBytes(bus_to_edges_)
+			+ memory::GetNodeContainerBytes(bus_to_removed_edges_);
+		for (const auto& [bus_name, edge_ids] : bus_to_edges_) {
+			result += memory::GetVectorBytes(edge_ids);
+		}
+		for (const auto& [bus_name, edge_ids] : bus_to_removed_edges_) {
+			result += edge_ids.size() * sizeof(graph::EdgeId);
+		}
+
+		return result;
+	}
 }
\ No newline at end of file
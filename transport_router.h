@@ -1,14 +1,23 @@
 #pragma once
 
+#include "flat_hash_map.h"
+#include "geo.h"
 #include "graph.h"
+#include "memory_usage.h"
+#include "parallel.h"
 #include "router.h"
+#include "shortest_paths.h"
+#include "spatial_index.h"
 
 #include <string>
 #include <optional>
 #include <utility>
 #include <unordered_map>
+#include <deque>
+#include <memory>
 #include <string_view>
 #include <vector>
+#include <variant>
 #include <functional>
 
 namespace transport {
@@ -32,57 +41,187 @@ namespace transport {
 		double           time;
 	};
 
+	// A walking leg between an arbitrary point and a stop, or between two points when stop_name is empty
+	struct RouteItemWalk {
+		std::optional<std::string_view> stop_name;
+		double                          distance;
+		double                          time;
+	};
+
 	struct RouteItem {
 		std::optional<RouteItemWait> wait_item;
 		std::optional<RouteItemBus>  bus_item;
+		std::optional<RouteItemWalk> walk_item;
 	};
 
+	// An end of a route: a stop or an arbitrary point, which is connected on foot to its nearest stops
+	using RoutePoint = std::variant<std::string_view, geo::Coordinates>;
+
 	struct RouteInfo {
 		double total_time = 0.;
 		std::vector<RouteItem> items;
 	};
 
+	// Stops of a bus in the riding order, distances[i] is the road distance from stops[i] to stops[i + 1]
+	struct BusRoute {
+		std::string_view              bus_name;
+		std::vector<std::string_view> stops;
+		std::vector<int>              distances;
+	};
+
+	struct ReachableStop {
+		std::string_view stop_name;
+		double           time;
+	};
+
+	// total_times[i][j] is the time from the i-th origin to the j-th destination, empty if there is no route
+	using TimeMatrix = std::vector<std::vector<std::optional<double>>>;
+
+	enum class RouterBackend {
+		// All-pairs table: a route is read from the table, which takes V^2 cells and O(V^3) to build
+		ROUTES_TABLE,
+		// Dijkstra over the graph on every query, nothing is built beyond the graph
+		PER_QUERY_SEARCH,
+	};
+
+	std::string_view BackendToString(RouterBackend backend);
+
+	// What a backend would take for a graph, the times are rough figures for a present-day core
+	struct RouterBackendEstimate {
+		RouterBackend backend;
+		size_t        memory_bytes  = 0;
+		double        build_seconds = 0.;
+		double        query_seconds = 0.;
+	};
+
 	class Router {
+	public:
+		static constexpr double DEFAULT_WALKING_VELOCITY   = 5.;
+		static constexpr size_t DEFAULT_WALKING_STOP_COUNT = 5;
+		static constexpr size_t DEFAULT_MEMORY_BUDGET      = size_t(1) << 30;
+
+		// One per backend
+		static std::vector<RouterBackendEstimate> EstimateBackends(size_t vertex_count, size_t edge_count);
+
 	private:
 		static constexpr double TO_MINUTES = (3.6 / 60.0);
 
 		using Graph   = graph::DirectedWeightedGraph<double>;
-		using RouterG = graph::Router<double>;
+		using RouterG = graph::CompactRouter<double>;
 
 		struct Settings {
-			double wait_time = 6;
-			double velocity  = 40.;
+			double wait_time          = 6;
+			double velocity           = 40.;
+			double walking_velocity   = DEFAULT_WALKING_VELOCITY;
+			size_t walking_stop_count = DEFAULT_WALKING_STOP_COUNT;
 		};
 
 		struct Vertexes {
-			size_t start_wait;
-			size_t end_wait;
+			size_t start_wait = 0;
+			size_t end_wait   = 0;
+		};
+		using StopToVertexes = containers::FlatHashMap<std::string_view, Vertexes>;
+
+		// Everything the queries read, never changed after it has been published
+		struct RoutingState {
+			RoutingState(Graph&& f_graph, std::vector<EdgeInfo>&& f_edges, StopToVertexes&& f_stop_to_vertex_id);
+
+			RoutingState(const RoutingState&) = delete;
+			RoutingState& operator=(const RoutingState&) = delete;
+
+			Graph                 graph;
+			std::vector<EdgeInfo> edges;
+			StopToVertexes        stop_to_vertex_id;
+			// Refers to graph, empty with the per-query search
+			std::optional<RouterG> router;
+
+			// Ids in the spatial index are the positions in stop_names, the i-th stop waits at the vertex 2 * i
+			std::vector<std::string_view>              stop_names;
+			std::shared_ptr<const spatial::PointIndex> stops_index;
+			// Copied from the settings at Commit, so the queries don't read the settings the writer changes
+			double                                     walking_velocity    = DEFAULT_WALKING_VELOCITY;
+			size_t                                     walking_stop_count  = DEFAULT_WALKING_STOP_COUNT;
+			// Of the writer's staged version as it was at Commit
+			size_t                                     staged_memory_usage = 0;
 		};
 
 	public:
+		// A committed state, the queries read the one they are given, so that it can be published along with
+		// the catalogue snapshot it was built from
+		using StatePtr = std::shared_ptr<const RoutingState>;
+
 		Router() = default;
-		explicit Router(const size_t graph_size);
 
 		void SetSettings(const double bus_wait_time, const double bus_velocity);
+		void SetWalkingSettings(const double walking_velocity, const size_t walking_stop_count);
+		// Commit picks the fastest backend that fits the budget. Without a budget it is half of the physical
+		// memory, or DEFAULT_MEMORY_BUDGET where that is unknown.
+		void SetMemoryBudget(const size_t memory_budget);
+		// The searches between stops the committed state is going to answer. The fastest backend takes the least
+		// to build and answer them. Without the count it answers a query the fastest, as for a long-running stream.
+		void SetExpectedQueryCount(const size_t query_count);
 		void AddWaitEdge(const std::string_view stop_name);
 		void AddBusEdge(const std::string_view stop_from, const std::string_view stop_to, const std::string_view bus_name, const int span_count, const int dist);
-		void AddStop(const std::string_view stop_name);
-
-		void BuildGraph();
-		void BuildRouter();
-
-		std::optional<RouteInfo> GetRouteInfo(const std::string_view from, const std::string_view to) const;
+		// Adds the edges between every stop of a route and every later one, as AddBusEdge would in the same order
+		void AddBusRoutes(const std::vector<BusRoute>& routes);
+		void AddStop(const std::string_view stop_name, geo::Coordinates coordinates);
+
+		// Update API: changes are staged and become visible to the queries only after Commit.
+		// Queries running meanwhile keep reading the previously committed state.
+		void RemoveBusEdges(const std::string_view bus_name);
+		void SetWaitTime(const double bus_wait_time);
+		void Commit();
+
+		// Null before the first Commit. Takes no locks, may be called from any thread.
+		StatePtr GetState() const;
+
+		std::optional<RouteInfo> GetRouteInfo(const StatePtr& state, const std::string_view from, const std::string_view to)             const;
+		// Points are joined to the graph by walking edges of a per-query overlay, the committed graph is shared as is
+		std::optional<RouteInfo> GetRouteInfo(const StatePtr& state, const RoutePoint& from, const RoutePoint& to)                       const;
+		// Same as GetRouteInfo for every destination, with one search from the origin for all of them
+		std::vector<std::optional<RouteInfo>> GetRouteInfos(const StatePtr& state, const std::string_view from, const std::vector<std::string_view>& to) const;
+		TimeMatrix               GetTotalTimes(const StatePtr& state, const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const;
+
+		std::optional<std::vector<ReachableStop>> GetReachableStops(const StatePtr& state, const std::string_view from, const double max_time) const;
+
+		// Of the committed state
+		size_t GetVertexCount() const;
+		size_t GetEdgeCount()   const;
+		std::optional<RouterBackend> GetBackend() const;
+		// Of the state, and of the staged version as it was committed in a single item. Empty without a state.
+		memory::Report GetMemoryReport(const StatePtr& state) const;
 
 	private:
-		std::optional<Graph>   graph_  = std::nullopt;
-		std::optional<RouterG> router_ = std::nullopt;
-
-		Settings settings_;
-
-		std::unordered_map<std::string_view, Vertexes, std::hash<std::string_view>> stop_to_vertex_id_;
-		std::vector<EdgeInfo> edges_;
-
-		void AddEdgesToGraph();
-		std::vector<RouteItem> MakeItemsByEdgeIds(const std::vector<graph::EdgeId>& edge_ids) const;
+		// The last committed state as the writer reads it, and as it is published to the readers
+		StatePtr                                   state_;
+		parallel::PublishedPtr<const RoutingState> published_state_;
+
+		Settings              settings_;
+		std::optional<size_t> memory_budget_;
+		std::optional<size_t> expected_query_count_;
+
+		// Staged version of the state: ids below committed_edge_count_ are the edge ids of state_
+		StopToVertexes                                                                stop_to_vertex_id_;
+		std::vector<std::string_view>                                                 stop_names_;
+		std::vector<geo::Coordinates>                                                 stop_coordinates_;
+		std::vector<EdgeInfo>                                                         edges_;
+		std::vector<bool>                                                             is_edge_removed_;
+		// The bus edges by the bus name, including the removed ones until Commit drops them
+		std::unordered_map<std::string_view, std::vector<graph::EdgeId>>              bus_to_edges_;
+		std::unordered_map<std::string_view, std::deque<graph::EdgeId>>               bus_to_removed_edges_;
+		size_t                                                                        committed_edge_count_ = 0;
+
+		RouterBackend          ChooseBackend(size_t vertex_count, size_t edge_count) const;
+		// Updates the table of prev_state if it is given and has one. Leaves the state with the per-query search
+		// if the table can't be allocated.
+		void                   BuildRoutesTable(RoutingState& state, const RoutingState* prev_state, const graph::EdgesUpdate& update) const;
+		bool                   TryRestoreBusEdge(const EdgeInfo& edge_info);
+		EdgeInfo               MakeBusEdge(const Vertexes& from, const Vertexes& to, const std::string_view bus_name, const int span_count, const int dist) const;
+		std::optional<size_t>  FindStartWaitVertex(const RoutingState& state, const std::string_view stop_name) const;
+		// Ids past the edges of the state are the overlay edges described by walk_items
+		std::vector<RouteItem> MakeItemsByEdgeIds(const RoutingState& state, const std::vector<graph::EdgeId>& edge_ids,
+			const std::vector<RouteItemWalk>& walk_items = {}) const;
+		static double          ComputeWalkingTime(const RoutingState& state, double distance);
+		size_t                 GetStagedMemoryUsage() const;
 	};
-}
\ No newline at end of file
+}
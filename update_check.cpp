@@ -0,0 +1,223 @@
+#include "update_check.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+	using namespace std::literals;
+
+	namespace {
+
+		// The routes table keeps float weights, equal routes of the two routers may differ in the last digits
+		constexpr double TIME_TOLERANCE             = 1e-5;
+		constexpr size_t DISTANCE_UPDATES_PER_ROUND = 2;
+		constexpr size_t ROUND_KIND_COUNT           = 4;
+
+		// A catalogue with its router, loaded from the base requests of a document
+		struct LoadedCity {
+			renderer::MapRenderer           mr;
+			transport::TransportCatalogue   db;
+			request_handler::RequestHandler rh{ db, mr };
+			json_reader::JsonReader         reader{ rh };
+		};
+
+		// Nodes are immutable, a changed field makes a new dict
+		json::Node WithField(const json::Node& node, const std::string& key, json::Node value) {
+			json::Dict dict = node.AsDict();
+			dict[key] = std::move(value);
+			return json::Node(std::move(dict));
+		}
+
+		// The generated document with the changes made to the live city, to load the same city from scratch
+		class UpdatedDocument {
+		public:
+			explicit UpdatedDocument(const json::Document& doc)
+				: root_(doc.GetRoot().AsDict())
+				, base_requests_(json::At(root_, "base_requests"sv).AsArray()) {
+			}
+
+			void SetDistance(std::string_view from, std::string_view to, int distance) {
+				json::Node& stop = base_requests_[FindRequest("Stop"sv, from)];
+				stop = WithField(stop, "road_distances"s, WithField(json::At(stop.AsDict(), "road_distances"sv), std::string(to), json::Node(distance)));
+			}
+
+			void SetBusWaitTime(int bus_wait_time) {
+				json::Node& settings = root_.at("routing_settings"s);
+				settings = WithField(settings, "bus_wait_time"s, json::Node(bus_wait_time));
+			}
+
+			// Returns the position of the removed request to put it back
+			size_t RemoveBus(std::string_view name) {
+				const size_t position = FindRequest("Bus"sv, name);
+				removed_bus_ = std::move(base_requests_[position]);
+				base_requests_.erase(base_requests_.begin() + position);
+				return position;
+			}
+
+			void RestoreBus(size_t position) {
+				base_requests_.insert(base_requests_.begin() + position, std::move(removed_bus_));
+			}
+
+			std::unique_ptr<LoadedCity> Load() const {
+				json::Dict root = root_;
+				root["base_requests"s] = json::Node(base_requests_);
+				std::ostringstream document;
+				json::Print(json::Document(json::Node(std::move(root))), document);
+
+				auto city = std::make_unique<LoadedCity>();
+				std::istringstream in(document.str());
+				city->reader.LoadBase(in);
+				return city;
+			}
+
+		private:
+			json::Dict  root_;
+			json::Array base_requests_;
+			json::Node  removed_bus_;
+
+			size_t FindRequest(std::string_view type, std::string_view name) const {
+				const auto it = std::find_if(base_requests_.begin(), base_requests_.end(), [type, name](const json::Node& request) {
+					const json::Dict& dict = request.AsDict();
+					return json::At(dict, "type"sv).AsString() == type && json::At(dict, "name"sv).AsString() == name;
+				});
+				return static_cast<size_t>(it - base_requests_.begin());
+			}
+		};
+
+		std::string TimeToString(const std::optional<double>& time) {
+			if (!time) {
+				return "unreachable"s;
+			}
+			std::ostringstream out;
+			out << *time;
+			return out.str();
+		}
+
+		// The number of ordered pairs of stops whose travel times differ, the first of them is described in example
+		size_t CountDifferences(const LoadedCity& updated, const LoadedCity& rebuilt, std::string& example) {
+			std::vector<std::string_view> names;
+			for (const domain::StopPtr& stop : updated.rh.GetStopsInVector()) {
+				names.push_back(stop->name);
+			}
+			const transport::TimeMatrix updated_times = updated.rh.GetTotalTimes(names, names);
+			const transport::TimeMatrix rebuilt_times = rebuilt.rh.GetTotalTimes(names, names);
+
+			size_t result = 0;
+			for (size_t i = 0; i < names.size(); ++i) {
+				for (size_t j = 0; j < names.size(); ++j) {
+					const std::optional<double>& lhs = updated_times[i][j];
+					const std::optional<double>& rhs = rebuilt_times[i][j];
+					const bool is_equal = lhs.has_value() == rhs.has_value()
+						&& (!lhs || std::abs(*lhs - *rhs) <= TIME_TOLERANCE * std::max(1., std::abs(*rhs)));
+					if (is_equal) {
+						continue;
+					}
+					if (result == 0) {
+						example = std::string(names[i]) + " -> "s + std::string(names[j]) + ": "s
+							+ TimeToString(lhs) + " updated, "s + TimeToString(rhs) + " rebuilt"s;
+					}
+					++result;
+				}
+			}
+			return result;
+		}
+	}
+
+	CityParams GetUpdateCheckCity() {
+		CityParams params;
+		params.stop_count         = 300;
+		params.bus_count          = 30;
+		params.stat_request_count = 0;
+		params.map_request_count  = 0;
+		return params;
+	}
+
+	size_t CheckUpdates(const CityParams& params, size_t round_count, std::ostream& out) {
+		UpdatedDocument document(GenerateCity(params));
+		const std::unique_ptr<LoadedCity> city = document.Load();
+		request_handler::RequestHandler& rh = city->rh;
+
+		std::vector<std::string> bus_names;
+		for (const domain::BusPtr& bus : rh.GetBusesInVector()) {
+			bus_names.emplace_back(bus->name);
+		}
+		if (bus_names.empty()) {
+			out << "No buses to update"s << std::endl;
+			return 0;
+		}
+
+		std::mt19937_64 engine(params.seed);
+		const auto next_index = [&engine](size_t count) {
+			return static_cast<size_t>(engine() % count);
+		};
+
+		size_t failed_commits = 0;
+		const auto commit = [&](const std::string& change) {
+			rh.CommitUpdate();
+			std::string example;
+			const size_t difference_count = CountDifferences(*city, *document.Load(), example);
+			out << change << ": "s;
+			if (difference_count == 0) {
+				out << "ok"s;
+			} else {
+				out << difference_count << " travel times differ, "s << example;
+				++failed_commits;
+			}
+			out << std::endl;
+		};
+
+		for (size_t round = 0; round < round_count; ++round) {
+			switch (round % ROUND_KIND_COUNT) {
+			case 0:
+			case 1: {
+				const bool is_shorter = round % ROUND_KIND_COUNT == 0;
+				for (size_t i = 0; i < DISTANCE_UPDATES_PER_ROUND; ++i) {
+					const domain::BusPtr bus = rh.SearchBus(bus_names[next_index(bus_names.size())]);
+					if (bus->route.size() < 2) {
+						continue;
+					}
+					const size_t from = next_index(bus->route.size() - 1);
+					const std::string_view from_name = bus->route[from]->name;
+					const std::string_view to_name   = bus->route[from + 1]->name;
+					const int distance = rh.GetActualDistanceBetweenStops(from_name, to_name).value_or(0);
+					const int new_distance = is_shorter ? std::max(1, distance / 2) : distance * 2 + 100;
+					rh.UpdateDistanceBetweenStops(from_name, to_name, new_distance);
+					document.SetDistance(from_name, to_name, new_distance);
+				}
+				commit(is_shorter ? "shorter distances"s : "longer distances"s);
+				break;
+			}
+			case 2: {
+				const int bus_wait_time = 1 + static_cast<int>(next_index(10));
+				rh.SetBusWaitTime(bus_wait_time);
+				document.SetBusWaitTime(bus_wait_time);
+				commit("bus wait time "s + std::to_string(bus_wait_time));
+				break;
+			}
+			default: {
+				const std::string& bus_name = bus_names[next_index(bus_names.size())];
+				rh.RemoveBusFromRouter(bus_name);
+				const size_t position = document.RemoveBus(bus_name);
+				commit(bus_name + " removed"s);
+
+				rh.AddBusToRouter(rh.SearchBus(bus_name));
+				document.RestoreBus(position);
+				commit(bus_name + " added back"s);
+				break;
+			}
+			}
+		}
+		return failed_commits;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "city_generator.h"
+
+#include <ostream>
+
+namespace bench {
+
+	// Small enough for a router to be built from scratch after every commit
+	CityParams GetUpdateCheckCity();
+
+	// Applies rounds of live updates to the router of a generated city: road distances made shorter, road distances
+	// made longer, a new bus wait time, a bus removed and added back. After every commit the travel times between all
+	// the stops are compared with those of a router built from scratch for the document with the same changes.
+	// Prints a line per commit and returns the number of commits that differ.
+	size_t CheckUpdates(const CityParams& params, size_t round_count, std::ostream& out);
+}